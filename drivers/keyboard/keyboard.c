@@ -4,6 +4,13 @@
  * ================================================ */
 #include "keyboard.h"
 #include "../../include/kernel.h"
+#include "../vga/vga.h"
+
+#define SC_ALT 0x38
+#define SC_F1 0x3B
+#define SC_PAGE_UP 0x49
+#define SC_PAGE_DOWN 0x51
+#define SCROLLBACK_STEP 12      // Half a screen per key
 
 static const char scancode_to_ascii[128] = {
     0, 27, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', '\b',
@@ -20,6 +27,7 @@ static const char scancode_to_ascii_shift[128] = {
 };
 
 static bool shift_pressed = false;
+static bool alt_pressed = false;
 
 void keyboard_init(void) {
     // Clear keyboard buffer
@@ -35,6 +43,9 @@ bool keyboard_has_input(void) {
 char keyboard_getchar(void) {
     uint8_t scancode;
     
+    // Whatever was printed before waiting should be on screen now
+    vga_flush();
+    
     while (1) {
         // Wait for data
         while (!(inb(0x64) & 1)) {
@@ -50,6 +61,9 @@ char keyboard_getchar(void) {
             if (scancode == 0x2A || scancode == 0x36) {
                 shift_pressed = false;
             }
+            if (scancode == SC_ALT) {
+                alt_pressed = false;
+            }
             continue;
         }
         
@@ -59,6 +73,27 @@ char keyboard_getchar(void) {
             continue;
         }
         
+        if (scancode == SC_ALT) {
+            alt_pressed = true;
+            continue;
+        }
+        
+        // Alt+F1..F4 switch virtual console
+        if (alt_pressed && scancode >= SC_F1 && scancode < SC_F1 + VGA_CONSOLES) {
+            int index = scancode - SC_F1;
+            if (index != vga_get_console()) {
+                vga_switch_console(index);
+                return KEY_CONSOLE_SWITCH;
+            }
+            continue;
+        }
+        
+        // Shift+PgUp/PgDn page through the console scrollback
+        if (shift_pressed && (scancode == SC_PAGE_UP || scancode == SC_PAGE_DOWN)) {
+            vga_scroll_view(scancode == SC_PAGE_UP ? -SCROLLBACK_STEP : SCROLLBACK_STEP);
+            continue;
+        }
+        
         // Convert to ASCII
         if (scancode < 128) {
             char c;
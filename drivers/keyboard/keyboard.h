@@ -3,6 +3,10 @@
 
 #include "../../include/types.h"
 
+// Returned by keyboard_getchar after Alt+Fn changed the console, so
+// line editors can redraw on the new one.
+#define KEY_CONSOLE_SWITCH '\x1e'
+
 void keyboard_init(void);
 char keyboard_getchar(void);
 bool keyboard_has_input(void);
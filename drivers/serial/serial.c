@@ -1,2 +1,89 @@
+/* ================================================
+ * drivers/serial/serial.c - 16550 UART on COM1
+ * ================================================ */
 #include "serial.h"
-void serial_init(void) {}
+#include "../../include/kernel.h"
+#include "../../kernel/irq.h"
+
+#define UART_DATA 0         // THR/RBR, divisor low with DLAB
+#define UART_IER  1         // Interrupt enable, divisor high with DLAB
+#define UART_FCR  2         // FIFO control (write) / IIR (read)
+#define UART_LCR  3
+#define UART_MCR  4
+#define UART_LSR  5
+
+#define IER_THRE 0x02
+#define LSR_THRE 0x20       // Transmit FIFO empty
+#define LCR_DLAB 0x80
+#define LCR_8N1  0x03
+#define MCR_DTR_RTS_OUT2 0x0B
+#define MCR_LOOPBACK 0x10
+
+#define SERIAL_IRQ 4
+#define BAUD_DIVISOR 1      // 115200 baud
+
+static bool present = false;
+static uint8_t ier = 0;
+static serial_tx_handler_t tx_handler = NULL;
+
+static void serial_irq(registers_t *regs) {
+    (void)regs;
+    inb(SERIAL_COM1 + UART_FCR);    // Reading IIR acknowledges THRE
+    if (tx_handler) tx_handler();
+}
+
+void serial_init(void) {
+    uint16_t port = SERIAL_COM1;
+    outb(port + UART_IER, 0x00);
+    outb(port + UART_LCR, LCR_DLAB);
+    outb(port + UART_DATA, BAUD_DIVISOR & 0xFF);
+    outb(port + UART_IER, BAUD_DIVISOR >> 8);
+    outb(port + UART_LCR, LCR_8N1);
+    outb(port + UART_FCR, 0xC7);    // Enable and clear FIFOs, 14-byte RX trigger
+
+    // Loopback self-test so a missing UART is not written to forever
+    outb(port + UART_MCR, MCR_LOOPBACK | 0x0E);
+    outb(port + UART_DATA, 0xAE);
+    if (inb(port + UART_DATA) != 0xAE) return;
+
+    outb(port + UART_MCR, MCR_DTR_RTS_OUT2);
+    irq_install_handler(SERIAL_IRQ, serial_irq);
+    present = true;
+}
+
+bool serial_present(void) {
+    return present;
+}
+
+bool serial_tx_empty(void) {
+    return present && (inb(SERIAL_COM1 + UART_LSR) & LSR_THRE);
+}
+
+size_t serial_fill_fifo(const char *data, size_t len) {
+    if (len > SERIAL_FIFO_SIZE) len = SERIAL_FIFO_SIZE;
+    for (size_t i = 0; i < len; i++) {
+        outb(SERIAL_COM1 + UART_DATA, data[i]);
+    }
+    return len;
+}
+
+void serial_set_tx_handler(serial_tx_handler_t handler) {
+    tx_handler = handler;
+}
+
+void serial_enable_tx_irq(bool enable) {
+    if (!present) return;
+    uint8_t want = enable ? (ier | IER_THRE) : (ier & ~IER_THRE);
+    if (want != ier) {
+        ier = want;
+        outb(SERIAL_COM1 + UART_IER, ier);
+    }
+}
+
+void serial_write(const char *data, size_t len) {
+    if (!present) return;
+    for (size_t i = 0; i < len; i++) {
+        while (!(inb(SERIAL_COM1 + UART_LSR) & LSR_THRE));
+        outb(SERIAL_COM1 + UART_DATA, data[i]);
+    }
+}
@@ -1,4 +1,27 @@
 #ifndef SERIAL_H
 #define SERIAL_H
+
+#include "../../include/types.h"
+
+#define SERIAL_COM1 0x3F8
+#define SERIAL_FIFO_SIZE 16
+
+typedef void (*serial_tx_handler_t)(void);
+
 void serial_init(void);
+bool serial_present(void);
+
+// Non-blocking transmit: when serial_tx_empty() is true the FIFO can
+// take up to SERIAL_FIFO_SIZE bytes through serial_fill_fifo().
+bool serial_tx_empty(void);
+size_t serial_fill_fifo(const char *data, size_t len);
+
+// The handler runs from IRQ4 each time the FIFO drains while the
+// transmit interrupt is enabled.
+void serial_set_tx_handler(serial_tx_handler_t handler);
+void serial_enable_tx_irq(bool enable);
+
+// Busy-waits; for panic paths only.
+void serial_write(const char *data, size_t len);
+
 #endif
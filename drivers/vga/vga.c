@@ -1,89 +1,618 @@
 #include "vga.h"
 #include "../../include/kernel.h"
+#include "../../lib/string/string.h"
+#include "../serial/serial.h"
 
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
 #define VGA_MEMORY ((uint16_t*)0xB8000)
 
-static int cursor_row = 0;
-static int cursor_col = 0;
-static uint8_t vga_color = 0x07;
+// Text memory holds far more rows than the screen shows. Scrolling
+// moves the CRTC start address down this ring; only when the bottom is
+// reached are the screen and the newest history copied back to the top.
+#define VGA_RING_ROWS 200       // 32000 bytes of the 32 KB window
+#define VGA_KEEP_ROWS 75        // Scrollback carried across a wrap
+#define VGA_NO_CURSOR (VGA_RING_ROWS * VGA_WIDTH)   // Never on screen
+#define VGA_RING_CELLS (VGA_RING_ROWS * VGA_WIDTH)
+#define VGA_DEFAULT_COLOR (VGA_COLOR_LIGHT_GREY | (VGA_COLOR_BLACK << 4))
 
-static void update_cursor(void) {
-    uint16_t pos = cursor_row * VGA_WIDTH + cursor_col;
-    outb(0x3D4, 14);
-    outb(0x3D5, (pos >> 8) & 0xFF);
-    outb(0x3D4, 15);
-    outb(0x3D5, pos & 0xFF);
+#define ESC_NONE 0
+#define ESC_START 1             // Seen ESC
+#define ESC_CSI 2               // Inside ESC [ ... final byte
+#define ESC_MAX_PARAMS 4
+
+// All drawing happens in a RAM copy of the ring. vga_flush() moves the
+// rows marked dirty to text memory in as few copies as possible, then
+// programs the CRTC, so a burst of output reaches the (emulated,
+// uncached) hardware once per tick instead of once per character.
+// Each virtual console has its own copy; only the one on screen is
+// ever flushed.
+typedef struct {
+    uint16_t cells[VGA_RING_CELLS];
+    uint32_t dirty[(VGA_RING_ROWS + 31) / 32];
+    int cursor_row;             // Relative to top_row
+    int cursor_col;
+    uint8_t color;
+    int top_row;                // Ring row at the top of the live screen
+    int view_row;               // Ring row being displayed
+    uint32_t scrolled;          // Lines scrolled since boot, for the mirror
+    uint8_t esc_state;
+    uint8_t esc_count;          // Parameters started so far
+    uint16_t esc_params[ESC_MAX_PARAMS];
+} console_t;
+
+// ANSI colour numbers are ordered red-green-blue, VGA's blue-green-red
+static const uint8_t ansi_to_vga[8] = {
+    VGA_COLOR_BLACK, VGA_COLOR_RED, VGA_COLOR_GREEN, VGA_COLOR_BROWN,
+    VGA_COLOR_BLUE, VGA_COLOR_MAGENTA, VGA_COLOR_CYAN, VGA_COLOR_LIGHT_GREY
+};
+
+static console_t consoles[VGA_CONSOLES];
+static console_t *con = &consoles[0];   // On screen and receiving output
+static volatile bool busy = false;      // Mid-update or mid-flush
+static uint16_t hw_cursor = 0xFFFF;     // Last values sent to the CRTC
+static uint16_t hw_start = 0xFFFF;
+
+static void crtc_write16(uint8_t high_reg, uint16_t value) {
+    outb(0x3D4, high_reg);
+    outb(0x3D5, (value >> 8) & 0xFF);
+    outb(0x3D4, high_reg + 1);
+    outb(0x3D5, value & 0xFF);
+}
+
+// Each port write is a VM exit under emulation, so the registers are
+// only programmed once per flush and only when they actually change.
+static void update_crtc(void) {
+    uint16_t start = con->view_row * VGA_WIDTH;
+    uint16_t pos = (con->top_row + con->cursor_row) * VGA_WIDTH + con->cursor_col;
+    if (con->view_row != con->top_row) pos = VGA_NO_CURSOR;
+
+    if (start != hw_start) {
+        hw_start = start;
+        crtc_write16(0x0C, start);
+    }
+    if (pos != hw_cursor) {
+        hw_cursor = pos;
+        crtc_write16(0x0E, pos);
+    }
+}
+
+// The timer tick flushes too, so it must never see a half-made update.
+static void begin_update(void) {
+    busy = true;
+    __asm__ volatile("" : : : "memory");
+}
+
+static void end_update(void) {
+    __asm__ volatile("" : : : "memory");
+    busy = false;
 }
 
 static uint16_t vga_entry(char c, uint8_t color) {
     return (uint16_t)c | ((uint16_t)color << 8);
 }
 
+static void mark_dirty(int ring_row) {
+    con->dirty[ring_row / 32] |= 1u << (ring_row % 32);
+}
+
+static uint16_t *row_cells(int row) {
+    mark_dirty(con->top_row + row);
+    return &con->cells[(con->top_row + row) * VGA_WIDTH];
+}
+
+static void blank_row(int row) {
+    uint16_t *cells = row_cells(row);
+    for (int x = 0; x < VGA_WIDTH; x++) {
+        cells[x] = vga_entry(' ', con->color);
+    }
+}
+
 static void vga_scroll(void) {
-    for (int y = 0; y < VGA_HEIGHT - 1; y++) {
-        for (int x = 0; x < VGA_WIDTH; x++) {
-            VGA_MEMORY[y * VGA_WIDTH + x] = VGA_MEMORY[(y + 1) * VGA_WIDTH + x];
+    if (con->top_row + VGA_HEIGHT >= VGA_RING_ROWS) {
+        int from = con->top_row - VGA_KEEP_ROWS;
+        memmove(con->cells, &con->cells[from * VGA_WIDTH],
+                (VGA_KEEP_ROWS + VGA_HEIGHT) * VGA_WIDTH * sizeof(uint16_t));
+        for (int row = 0; row < VGA_KEEP_ROWS + VGA_HEIGHT; row++) {
+            mark_dirty(row);
         }
+        con->top_row = VGA_KEEP_ROWS;
     }
-    for (int x = 0; x < VGA_WIDTH; x++) {
-        VGA_MEMORY[(VGA_HEIGHT - 1) * VGA_WIDTH + x] = vga_entry(' ', vga_color);
-    }
-    cursor_row = VGA_HEIGHT - 1;
+    con->top_row++;
+    con->view_row = con->top_row;
+    con->scrolled++;
+    blank_row(VGA_HEIGHT - 1);
+    con->cursor_row = VGA_HEIGHT - 1;
+}
+
+static void mirror_update(void);
+
+static void mark_all_dirty(void) {
+    memset(con->dirty, 0xFF, sizeof(con->dirty));
 }
 
 void vga_init(void) {
-    vga_color = VGA_COLOR_LIGHT_GREY | (VGA_COLOR_BLACK << 4);
-    cursor_row = 0;
-    cursor_col = 0;
+    for (int i = 0; i < VGA_CONSOLES; i++) {
+        con = &consoles[i];
+        con->color = VGA_DEFAULT_COLOR;
+        con->esc_state = ESC_NONE;
+        con->cursor_row = 0;
+        con->cursor_col = 0;
+        con->top_row = 0;
+        con->view_row = 0;
+        for (int y = 0; y < VGA_HEIGHT; y++) {
+            blank_row(y);
+        }
+    }
+    con = &consoles[0];
+    mark_all_dirty();
+    hw_cursor = 0xFFFF;
+    hw_start = 0xFFFF;
+}
+
+void vga_flush(void) {
+    if (busy) return;
+    begin_update();
+
+    for (int row = 0; row < VGA_RING_ROWS; ) {
+        if (!(con->dirty[row / 32] & (1u << (row % 32)))) {
+            row++;
+            continue;
+        }
+        int first = row;
+        while (row < VGA_RING_ROWS && (con->dirty[row / 32] & (1u << (row % 32)))) {
+            con->dirty[row / 32] &= ~(1u << (row % 32));
+            row++;
+        }
+        memcpy(&VGA_MEMORY[first * VGA_WIDTH], &con->cells[first * VGA_WIDTH],
+               (row - first) * VGA_WIDTH * sizeof(uint16_t));
+    }
+    update_crtc();
+    mirror_update();
+    end_update();
 }
 
 void vga_clear(void) {
+    begin_update();
+    con->top_row = 0;
+    con->view_row = 0;
     for (int y = 0; y < VGA_HEIGHT; y++) {
-        for (int x = 0; x < VGA_WIDTH; x++) {
-            VGA_MEMORY[y * VGA_WIDTH + x] = vga_entry(' ', vga_color);
-        }
+        blank_row(y);
     }
-    cursor_row = 0;
-    cursor_col = 0;
-    update_cursor();
+    con->cursor_row = 0;
+    con->cursor_col = 0;
+    end_update();
 }
 
-void vga_putchar(char c) {
+static void blank_cells(int row, int from, int to) {
+    uint16_t *cells = row_cells(row);
+    for (int x = from; x < to; x++) {
+        cells[x] = vga_entry(' ', con->color);
+    }
+}
+
+static int esc_param(int index, int fallback) {
+    if (index >= con->esc_count || con->esc_params[index] == 0) return fallback;
+    return con->esc_params[index];
+}
+
+static int clamp(int value, int low, int high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+static void ansi_sgr(int code) {
+    uint8_t fg = con->color & 0x0F;
+    uint8_t bg = con->color >> 4;
+    if (code == 0) {
+        fg = VGA_DEFAULT_COLOR & 0x0F;
+        bg = VGA_DEFAULT_COLOR >> 4;
+    } else if (code == 1) {
+        fg |= 0x08;             // Bold shows as the bright variant
+    } else if (code == 22) {
+        fg &= 0x07;
+    } else if (code >= 30 && code <= 37) {
+        fg = (fg & 0x08) | ansi_to_vga[code - 30];
+    } else if (code == 39) {
+        fg = (fg & 0x08) | (VGA_DEFAULT_COLOR & 0x07);
+    } else if (code >= 40 && code <= 47) {
+        bg = ansi_to_vga[code - 40];
+    } else if (code == 49) {
+        bg = VGA_DEFAULT_COLOR >> 4;
+    } else if (code >= 90 && code <= 97) {
+        fg = 0x08 | ansi_to_vga[code - 90];
+    } else if (code >= 100 && code <= 107) {
+        bg = 0x08 | ansi_to_vga[code - 100];
+    }
+    con->color = fg | (bg << 4);
+}
+
+static void ansi_execute(char final) {
+    int row = con->cursor_row;
+    int col = con->cursor_col;
+    int n = esc_param(0, 1);
+
+    switch (final) {
+        case 'm':
+            if (con->esc_count == 0) ansi_sgr(0);
+            for (int i = 0; i < con->esc_count; i++) ansi_sgr(con->esc_params[i]);
+            break;
+        case 'A': con->cursor_row = clamp(row - n, 0, VGA_HEIGHT - 1); break;
+        case 'B': con->cursor_row = clamp(row + n, 0, VGA_HEIGHT - 1); break;
+        case 'C': con->cursor_col = clamp(col + n, 0, VGA_WIDTH - 1); break;
+        case 'D': con->cursor_col = clamp(col - n, 0, VGA_WIDTH - 1); break;
+        case 'H':
+        case 'f':
+            con->cursor_row = clamp(n - 1, 0, VGA_HEIGHT - 1);
+            con->cursor_col = clamp(esc_param(1, 1) - 1, 0, VGA_WIDTH - 1);
+            break;
+        case 'K':
+            n = esc_param(0, 0);
+            blank_cells(row, n == 0 ? col : 0, n == 1 ? col + 1 : VGA_WIDTH);
+            break;
+        case 'J':
+            n = esc_param(0, 0);
+            if (n == 0) {
+                blank_cells(row, col, VGA_WIDTH);
+                for (int y = row + 1; y < VGA_HEIGHT; y++) blank_row(y);
+            } else if (n == 1) {
+                for (int y = 0; y < row; y++) blank_row(y);
+                blank_cells(row, 0, col + 1);
+            } else {
+                for (int y = 0; y < VGA_HEIGHT; y++) blank_row(y);
+            }
+            break;
+    }
+}
+
+// Escape sequences: SGR colours, cursor movement (CUU/CUD/CUF/CUB/CUP)
+// and erase in line/display. Anything else is swallowed.
+static void ansi_feed(char c) {
+    if (con->esc_state == ESC_NONE) {
+        con->esc_state = ESC_START;
+    } else if (con->esc_state == ESC_START) {
+        // Other escapes (like ESC ( B) end at their first non-intermediate byte
+        if (c >= 0x20 && c <= 0x2F) return;
+        con->esc_state = (c == '[') ? ESC_CSI : ESC_NONE;
+        con->esc_count = 0;
+        memset(con->esc_params, 0, sizeof(con->esc_params));
+    } else if (c >= '0' && c <= '9') {
+        if (con->esc_count == 0) con->esc_count = 1;
+        uint16_t *param = &con->esc_params[con->esc_count - 1];
+        if (*param < 1000) *param = *param * 10 + (c - '0');
+    } else if (c == ';') {
+        if (con->esc_count == 0) con->esc_count = 1;
+        if (con->esc_count < ESC_MAX_PARAMS) con->esc_count++;
+    } else if (c >= 0x40 && c <= 0x7E) {
+        ansi_execute(c);
+        con->esc_state = ESC_NONE;
+    } else if (c < 0x20 || c > 0x3F) {
+        con->esc_state = ESC_NONE;      // Not a CSI byte: give up on it
+    }
+}
+
+// Moves the cursor and draws cells without touching the CRTC.
+static void put_char(char c) {
+    if (con->esc_state != ESC_NONE || c == '\x1b') {
+        ansi_feed(c);
+        return;
+    }
+
     if (c == '\n') {
-        cursor_col = 0;
-        cursor_row++;
+        con->cursor_col = 0;
+        con->cursor_row++;
     } else if (c == '\r') {
-        cursor_col = 0;
+        con->cursor_col = 0;
     } else if (c == '\b') {
-        if (cursor_col > 0) {
-            cursor_col--;
-            VGA_MEMORY[cursor_row * VGA_WIDTH + cursor_col] = vga_entry(' ', vga_color);
+        if (con->cursor_col > 0) {
+            con->cursor_col--;
+            row_cells(con->cursor_row)[con->cursor_col] = vga_entry(' ', con->color);
         }
     } else if (c >= 32 && c <= 126) {
-        VGA_MEMORY[cursor_row * VGA_WIDTH + cursor_col] = vga_entry(c, vga_color);
-        cursor_col++;
+        row_cells(con->cursor_row)[con->cursor_col] = vga_entry(c, con->color);
+        con->cursor_col++;
     }
-    
-    if (cursor_col >= VGA_WIDTH) {
-        cursor_col = 0;
-        cursor_row++;
+
+    if (con->cursor_col >= VGA_WIDTH) {
+        con->cursor_col = 0;
+        con->cursor_row++;
     }
-    
-    if (cursor_row >= VGA_HEIGHT) {
+
+    if (con->cursor_row >= VGA_HEIGHT) {
         vga_scroll();
     }
-    
-    update_cursor();
+}
+
+void vga_putchar(char c) {
+    begin_update();
+    con->view_row = con->top_row;
+    put_char(c);
+    end_update();
 }
 
 void vga_puts(const char *str) {
-    while (*str) {
-        vga_putchar(*str++);
+    vga_write(str, strlen(str));
+}
+
+void vga_write(const char *data, size_t len) {
+    // New output always brings the live screen back into view
+    begin_update();
+    con->view_row = con->top_row;
+
+    size_t i = 0;
+    while (i < len) {
+        // Printable runs go straight into the current row's cells,
+        // unless an escape sequence is being collected
+        uint16_t *cell = row_cells(con->cursor_row) + con->cursor_col;
+        uint16_t attr = (uint16_t)con->color << 8;
+        int room = con->esc_state == ESC_NONE ? VGA_WIDTH - con->cursor_col : 0;
+        int n = 0;
+        while (n < room && i < len && data[i] >= 32 && data[i] <= 126) {
+            cell[n++] = (uint8_t)data[i++] | attr;
+        }
+        con->cursor_col += n;
+        if (con->cursor_col >= VGA_WIDTH) {
+            con->cursor_col = 0;
+            if (++con->cursor_row >= VGA_HEIGHT) vga_scroll();
+        } else if (n == 0) {
+            put_char(data[i++]);
+        }
     }
+    end_update();
+}
+
+void vga_scroll_view(int rows) {
+    // Everything above the live screen is history, back to ring row 0
+    con->view_row += rows;
+    if (con->view_row < 0) con->view_row = 0;
+    if (con->view_row > con->top_row) con->view_row = con->top_row;
+    vga_flush();
+}
+
+void vga_switch_console(int index) {
+    if (index < 0 || index >= VGA_CONSOLES || &consoles[index] == con) return;
+    begin_update();
+    con = &consoles[index];
+    // Text memory still holds the old console: repaint all of this one
+    mark_all_dirty();
+    end_update();
+    vga_flush();
+}
+
+int vga_get_console(void) {
+    return con - consoles;
 }
 
 void vga_set_color(uint8_t fg, uint8_t bg) {
-    vga_color = fg | (bg << 4);
+    con->color = fg | (bg << 4);
+}
+
+// ---------------------------------------------------------------
+// Serial mirror: keeps a terminal on COM1 showing what the screen
+// shows. Each flush compares the visible rows with what was last sent
+// and queues only the changed spans as ANSI text, using the terminal's
+// own scrolling when the console scrolled. The queue drains from the
+// UART interrupt, so a big repaint never stalls the tick.
+// ---------------------------------------------------------------
+#define MIRROR_QUEUE_SIZE 8192          // Power of two
+#define MIRROR_ROW_MAX 1024             // Worst case for one row of output
+#define MIRROR_TAIL_MAX 64              // Scroll or cursor commands around the rows
+#define MIRROR_UNKNOWN 0xFFFF           // Cell the terminal may not show
+
+static char mirror_queue[MIRROR_QUEUE_SIZE];
+static volatile uint32_t mirror_head = 0;       // Written by flush
+static volatile uint32_t mirror_tail = 0;       // Written by the UART IRQ
+static bool mirror_on = false;
+static uint16_t mirror_cells[VGA_HEIGHT * VGA_WIDTH];
+static const console_t *mirror_con = NULL;
+static uint32_t mirror_line;            // Absolute line at the terminal's top row
+static int mirror_row, mirror_col;      // Terminal cursor, -1 when unknown
+static int mirror_attr;                 // Terminal colours, -1 when unknown
+static bool mirror_cursor_shown;
+static uint32_t mirror_bytes = 0;
+
+static const uint8_t vga_to_ansi[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+typedef struct {
+    char data[MIRROR_ROW_MAX];
+    size_t len;
+} mirror_buf_t;
+
+static void buf_str(mirror_buf_t *buf, const char *str) {
+    while (*str) buf->data[buf->len++] = *str++;
+}
+
+static void buf_num(mirror_buf_t *buf, unsigned value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (n) buf->data[buf->len++] = digits[--n];
+}
+
+static void buf_csi(mirror_buf_t *buf, unsigned a, unsigned b, char final) {
+    buf_str(buf, "\x1b[");
+    buf_num(buf, a);
+    buf->data[buf->len++] = ';';
+    buf_num(buf, b);
+    buf->data[buf->len++] = final;
+}
+
+static void buf_move(mirror_buf_t *buf, int row, int col) {
+    if (row == mirror_row && col == mirror_col) return;
+    buf_csi(buf, row + 1, col + 1, 'H');
+    mirror_row = row;
+    mirror_col = col;
+}
+
+static void buf_attr(mirror_buf_t *buf, uint8_t attr) {
+    if (attr == mirror_attr) return;
+    uint8_t fg = attr & 0x0F, bg = attr >> 4;
+    buf_csi(buf, (fg & 8 ? 90 : 30) + vga_to_ansi[fg & 7],
+            (bg & 8 ? 100 : 40) + vga_to_ansi[bg & 7], 'm');
+    mirror_attr = attr;
+}
+
+static uint32_t mirror_room(void) {
+    return MIRROR_QUEUE_SIZE - (mirror_head - mirror_tail);
+}
+
+static void mirror_queue_put(const mirror_buf_t *buf) {
+    for (size_t i = 0; i < buf->len; i++) {
+        mirror_queue[(mirror_head + i) & (MIRROR_QUEUE_SIZE - 1)] = buf->data[i];
+    }
+    __asm__ volatile("" : : : "memory");
+    mirror_head += buf->len;
+    mirror_bytes += buf->len;
+}
+
+// UART transmit interrupt: refill the FIFO until the queue is empty.
+static void mirror_pump(void) {
+    if (!serial_tx_empty()) return;
+    size_t room = SERIAL_FIFO_SIZE;
+    while (room && mirror_tail != mirror_head) {
+        uint32_t offset = mirror_tail & (MIRROR_QUEUE_SIZE - 1);
+        size_t chunk = mirror_head - mirror_tail;
+        if (chunk > MIRROR_QUEUE_SIZE - offset) chunk = MIRROR_QUEUE_SIZE - offset;
+        if (chunk > room) chunk = room;
+        serial_fill_fifo(&mirror_queue[offset], chunk);
+        mirror_tail += chunk;
+        room -= chunk;
+    }
+    serial_enable_tx_irq(mirror_tail != mirror_head);
+}
+
+// Scrolls the terminal the way the console scrolled, so unchanged text
+// is moved there rather than sent again.
+static void mirror_scroll(mirror_buf_t *buf, uint32_t line) {
+    int delta = (int)(line - mirror_line);
+    mirror_line = line;
+    if (delta == 0) return;
+    if (delta >= VGA_HEIGHT || delta <= -VGA_HEIGHT) {
+        memset(mirror_cells, 0xFF, sizeof(mirror_cells));
+        return;
+    }
+
+    int count = delta > 0 ? delta : -delta;
+    int keep = (VGA_HEIGHT - count) * VGA_WIDTH;
+    buf_str(buf, "\x1b[");
+    buf_num(buf, count);
+    buf->data[buf->len++] = delta > 0 ? 'S' : 'T';
+    if (delta > 0) {
+        memmove(mirror_cells, &mirror_cells[count * VGA_WIDTH], keep * sizeof(uint16_t));
+        memset(&mirror_cells[keep], 0xFF, count * VGA_WIDTH * sizeof(uint16_t));
+    } else {
+        memmove(&mirror_cells[count * VGA_WIDTH], mirror_cells, keep * sizeof(uint16_t));
+        memset(mirror_cells, 0xFF, count * VGA_WIDTH * sizeof(uint16_t));
+    }
+}
+
+// Queues what it takes to make terminal row y match cells.
+static void mirror_row_diff(mirror_buf_t *buf, int y, const uint16_t *cells) {
+    uint16_t *seen = &mirror_cells[y * VGA_WIDTH];
+    int first = 0, last = VGA_WIDTH - 1;
+    while (first < VGA_WIDTH && cells[first] == seen[first]) first++;
+    if (first == VGA_WIDTH) return;
+    while (cells[last] == seen[last]) last--;
+
+    // A changed run of blanks to the end of the row is one erase-line
+    uint16_t blank = (cells[VGA_WIDTH - 1] & 0xFF00) | ' ';
+    int tail = VGA_WIDTH;
+    while (tail > first && cells[tail - 1] == blank) tail--;
+    int end = (tail <= last && VGA_WIDTH - tail > 4) ? tail : last + 1;
+
+    buf_move(buf, y, first);
+    for (int x = first; x < end; x++) {
+        buf_attr(buf, cells[x] >> 8);
+        buf->data[buf->len++] = (char)cells[x];
+        seen[x] = cells[x];
+    }
+    mirror_col = end;
+    if (end < VGA_WIDTH && end <= last) {
+        buf_attr(buf, blank >> 8);
+        buf_str(buf, "\x1b[K");
+        for (int x = end; x < VGA_WIDTH; x++) seen[x] = blank;
+    }
+    // Writing the last column leaves terminals in differing wrap states
+    if (mirror_col >= VGA_WIDTH) mirror_row = -1;
+}
+
+static void mirror_update(void) {
+    if (!mirror_on || mirror_room() < MIRROR_ROW_MAX + 2 * MIRROR_TAIL_MAX) return;
+    mirror_buf_t buf;
+    buf.len = 0;
+
+    // mirror_cells is what the terminal shows whichever console drew it,
+    // so a switch is diffed like any other change. Scroll counts are per
+    // console, though: take the new one's as the baseline, don't scroll.
+    uint32_t line = con->scrolled - (con->top_row - con->view_row);
+    if (mirror_con != con) {
+        mirror_con = con;
+        mirror_line = line;
+    }
+    mirror_scroll(&buf, line);
+
+    for (int y = 0; y < VGA_HEIGHT; y++) {
+        const uint16_t *cells = &con->cells[(con->view_row + y) * VGA_WIDTH];
+        if (memcmp(cells, &mirror_cells[y * VGA_WIDTH], VGA_WIDTH * sizeof(uint16_t)) == 0) continue;
+        if (mirror_room() < buf.len + MIRROR_ROW_MAX + MIRROR_TAIL_MAX) {
+            break;      // The rest goes out on a later flush
+        }
+        mirror_row_diff(&buf, y, cells);
+        mirror_queue_put(&buf);
+        buf.len = 0;
+    }
+
+    bool live = con->view_row == con->top_row;
+    if (live != mirror_cursor_shown) {
+        buf_str(&buf, live ? "\x1b[?25h" : "\x1b[?25l");
+        mirror_cursor_shown = live;
+    }
+    if (live) buf_move(&buf, con->cursor_row, con->cursor_col);
+
+    mirror_queue_put(&buf);
+    if (mirror_head != mirror_tail) {
+        serial_enable_tx_irq(true);     // Fires at once if the FIFO is idle
+    }
+}
+
+void vga_mirror_enable(bool enable) {
+    if (enable == mirror_on || !serial_present()) return;
+    begin_update();
+    mirror_on = enable;
+    if (enable) {
+        mirror_con = NULL;
+        mirror_line = 0;
+        memset(mirror_cells, 0xFF, sizeof(mirror_cells));     // Nothing known yet
+        mirror_row = -1;
+        mirror_col = -1;
+        mirror_attr = -1;
+        mirror_cursor_shown = false;
+        mirror_head = mirror_tail = 0;
+        serial_set_tx_handler(mirror_pump);
+        // Screen-sized scroll region so scrolling matches the console
+        mirror_buf_t buf;
+        buf.len = 0;
+        buf_str(&buf, "\x1b[0m\x1b[2J\x1b[?25l");
+        buf_csi(&buf, 1, VGA_HEIGHT, 'r');
+        mirror_queue_put(&buf);
+    } else {
+        // Drop what is still queued and hand the terminal back in a sane state
+        serial_enable_tx_irq(false);
+        serial_set_tx_handler(NULL);
+        mirror_head = mirror_tail;
+        static const char reset[] = "\x1b[r\x1b[0m\x1b[?25h\x1b[2J\x1b[H";
+        serial_write(reset, sizeof(reset) - 1);
+    }
+    end_update();
+    vga_flush();
+}
+
+bool vga_mirror_enabled(void) {
+    return mirror_on;
+}
+
+uint32_t vga_mirror_bytes(void) {
+    return mirror_bytes;
 }
@@ -20,10 +20,49 @@
 #define VGA_COLOR_YELLOW 14
 #define VGA_COLOR_WHITE 15
 
+#define VGA_CONSOLES 4
+
+// SGR sequences the console interprets, named after the VGA colour
+// each one selects. ANSI_RESET restores light grey on black.
+#define ANSI_RESET "\x1b[0m"
+#define ANSI_GREEN "\x1b[22;32m"
+#define ANSI_DARK_GREY "\x1b[90m"
+#define ANSI_LIGHT_RED "\x1b[91m"
+#define ANSI_LIGHT_GREEN "\x1b[92m"
+#define ANSI_YELLOW "\x1b[93m"
+#define ANSI_LIGHT_BLUE "\x1b[94m"
+#define ANSI_LIGHT_CYAN "\x1b[96m"
+#define ANSI_WHITE "\x1b[97m"
+
 void vga_init(void);
 void vga_clear(void);
 void vga_putchar(char c);
 void vga_puts(const char *str);
+// Also interprets ANSI escapes: SGR colours (30-37, 40-47, 90-97,
+// 100-107, 0, 1, 22, 39, 49), cursor movement (A B C D H f) and
+// erase in line or display (K J).
+void vga_write(const char *data, size_t len);
 void vga_set_color(uint8_t fg, uint8_t bg);
 
+// Drawing goes to a RAM shadow; this copies the changed rows to the
+// screen. The timer tick calls it, so only code that runs with
+// interrupts off or needs output visible immediately has to.
+void vga_flush(void);
+
+// Virtual consoles each keep their own text, scrollback, cursor and
+// colour. Switching shows the chosen one and sends output to it.
+void vga_switch_console(int index);
+int vga_get_console(void);
+
+// Mirrors the visible console to a terminal on COM1 as ANSI diffs.
+// Takes over the UART's transmit interrupt while enabled, so other
+// serial writers (the kernel log) must stand aside.
+void vga_mirror_enable(bool enable);
+bool vga_mirror_enabled(void);
+uint32_t vga_mirror_bytes(void);
+
+// Scrollback: negative rows look further back, positive come forward.
+// The view returns to the live screen on the next output.
+void vga_scroll_view(int rows);
+
 #endif
@@ -11,7 +11,7 @@ static char current_path[SIMFS_MAX_PATH] = "/";
 
 void simfs_init(void) {
     entry_count = 0;
-    strcpy(current_path, "/");
+    strlcpy(current_path, "/", sizeof(current_path));
     memset(entries, 0, sizeof(entries));
 }
 
@@ -23,67 +23,57 @@ static int path_equals(const char *p1, const char *p2) {
     return strcmp(p1, p2) == 0;
 }
 
+// Entries are created in the current directory under their bare name, so
+// a '/' would make a name that lookup() can never split back out.
+static bool valid_name(const char *name) {
+    size_t len = strlen(name);
+    return len < SIMFS_MAX_NAME && !memchr(name, '/', len);
+}
+
 char* simfs_resolve_path(const char *name, char *full_path) {
+    size_t len;
     if (name[0] == '/') {
-        strcpy(full_path, name);
+        len = strlcpy(full_path, name, SIMFS_MAX_PATH);
     } else {
-        if (path_equals(current_path, "/")) {
-            strcpy(full_path, "/");
-            strcat(full_path, name);
-        } else {
-            strcpy(full_path, current_path);
-            strcat(full_path, "/");
-            strcat(full_path, name);
-        }
+        len = path_join(full_path, SIMFS_MAX_PATH, current_path, name);
     }
-    return full_path;
+    return len < SIMFS_MAX_PATH ? full_path : NULL;
 }
 
-static simfs_entry_t* find_entry(const char *full_path, simfs_type_t type) {
-    for (int i = 0; i < entry_count; i++) {
-        if (!entries[i].in_use) continue;
-        
-        char entry_full_path[SIMFS_MAX_PATH];
-        if (path_equals(entries[i].parent_path, "/")) {
-            strcpy(entry_full_path, "/");
-            strcat(entry_full_path, entries[i].name);
-        } else {
-            strcpy(entry_full_path, entries[i].parent_path);
-            strcat(entry_full_path, "/");
-            strcat(entry_full_path, entries[i].name);
-        }
-        
-        if (path_equals(entry_full_path, full_path) && entries[i].type == type) {
-            return &entries[i];
-        }
+// Compares each entry's parent and name against the two halves of
+// full_path in place, instead of rebuilding every entry's path.
+static simfs_entry_t* lookup(const char *full_path, simfs_type_t type, bool any_type) {
+    const char *slash = NULL;
+    for (const char *p = full_path; *p; p++) {
+        if (*p == '/') slash = p;
+    }
+    if (!slash) return NULL;
+
+    const char *leaf = slash + 1;
+    size_t parent_len = slash == full_path ? 1 : (size_t)(slash - full_path);
+
+    for (int i = 0; i < SIMFS_MAX_FILES + SIMFS_MAX_DIRS; i++) {
+        simfs_entry_t *entry = &entries[i];
+        if (!entry->in_use) continue;
+        if (!any_type && entry->type != type) continue;
+        if (strncmp(entry->parent_path, full_path, parent_len) != 0) continue;
+        if (entry->parent_path[parent_len] != '\0') continue;
+        if (strcmp(entry->name, leaf) == 0) return entry;
     }
     return NULL;
 }
 
+static simfs_entry_t* find_entry(const char *full_path, simfs_type_t type) {
+    return lookup(full_path, type, false);
+}
+
 static simfs_entry_t* find_entry_any(const char *full_path) {
-    for (int i = 0; i < entry_count; i++) {
-        if (!entries[i].in_use) continue;
-        
-        char entry_full_path[SIMFS_MAX_PATH];
-        if (path_equals(entries[i].parent_path, "/")) {
-            strcpy(entry_full_path, "/");
-            strcat(entry_full_path, entries[i].name);
-        } else {
-            strcpy(entry_full_path, entries[i].parent_path);
-            strcat(entry_full_path, "/");
-            strcat(entry_full_path, entries[i].name);
-        }
-        
-        if (path_equals(entry_full_path, full_path)) {
-            return &entries[i];
-        }
-    }
-    return NULL;
+    return lookup(full_path, SIMFS_TYPE_FILE, true);
 }
 
 int simfs_set_cwd(const char *path) {
     if (path_equals(path, "/") || path_equals(path, "")) {
-        strcpy(current_path, "/");
+        strlcpy(current_path, "/", sizeof(current_path));
         return 0;
     }
     
@@ -95,23 +85,23 @@ int simfs_set_cwd(const char *path) {
         for (int i = len - 1; i >= 0; i--) {
             if (current_path[i] == '/') {
                 if (i == 0) {
-                    strcpy(current_path, "/");
+                    strlcpy(current_path, "/", sizeof(current_path));
                 } else {
                     current_path[i] = '\0';
                 }
                 return 0;
             }
         }
-        strcpy(current_path, "/");
+        strlcpy(current_path, "/", sizeof(current_path));
         return 0;
     }
     
     char full_path[SIMFS_MAX_PATH];
-    simfs_resolve_path(path, full_path);
+    if (!simfs_resolve_path(path, full_path)) return -1;
     
     simfs_entry_t *entry = find_entry(full_path, SIMFS_TYPE_DIR);
     if (entry) {
-        strcpy(current_path, full_path);
+        strlcpy(current_path, full_path, sizeof(current_path));
         return 0;
     }
     
@@ -123,8 +113,10 @@ int simfs_mkdir(const char *name) {
         return -1;
     }
     
+    if (!valid_name(name)) return -1;
+    
     char full_path[SIMFS_MAX_PATH];
-    simfs_resolve_path(name, full_path);
+    if (!simfs_resolve_path(name, full_path)) return -1;
     
     if (find_entry_any(full_path)) {
         return -2;
@@ -142,8 +134,8 @@ int simfs_mkdir(const char *name) {
     
     new_entry->in_use = true;
     new_entry->type = SIMFS_TYPE_DIR;
-    strcpy(new_entry->name, name);
-    strcpy(new_entry->parent_path, current_path);
+    strlcpy(new_entry->name, name, SIMFS_MAX_NAME);
+    strlcpy(new_entry->parent_path, current_path, SIMFS_MAX_PATH);
     new_entry->size = 0;
     new_entry->content[0] = '\0';
     entry_count++;
@@ -156,8 +148,10 @@ int simfs_touch(const char *name) {
         return -1;
     }
     
+    if (!valid_name(name)) return -1;
+    
     char full_path[SIMFS_MAX_PATH];
-    simfs_resolve_path(name, full_path);
+    if (!simfs_resolve_path(name, full_path)) return -1;
     
     if (find_entry_any(full_path)) {
         return -2;
@@ -175,8 +169,8 @@ int simfs_touch(const char *name) {
     
     new_entry->in_use = true;
     new_entry->type = SIMFS_TYPE_FILE;
-    strcpy(new_entry->name, name);
-    strcpy(new_entry->parent_path, current_path);
+    strlcpy(new_entry->name, name, SIMFS_MAX_NAME);
+    strlcpy(new_entry->parent_path, current_path, SIMFS_MAX_PATH);
     new_entry->size = 0;
     new_entry->content[0] = '\0';
     entry_count++;
@@ -186,7 +180,7 @@ int simfs_touch(const char *name) {
 
 int simfs_rm(const char *name) {
     char full_path[SIMFS_MAX_PATH];
-    simfs_resolve_path(name, full_path);
+    if (!simfs_resolve_path(name, full_path)) return -1;
     
     simfs_entry_t *entry = find_entry(full_path, SIMFS_TYPE_FILE);
     if (!entry) {
@@ -200,7 +194,7 @@ int simfs_rm(const char *name) {
 
 int simfs_rmdir(const char *name) {
     char full_path[SIMFS_MAX_PATH];
-    simfs_resolve_path(name, full_path);
+    if (!simfs_resolve_path(name, full_path)) return -1;
     
     simfs_entry_t *entry = find_entry(full_path, SIMFS_TYPE_DIR);
     if (!entry) {
@@ -220,7 +214,7 @@ int simfs_rmdir(const char *name) {
 
 int simfs_exists(const char *name, simfs_type_t *type) {
     char full_path[SIMFS_MAX_PATH];
-    simfs_resolve_path(name, full_path);
+    if (!simfs_resolve_path(name, full_path)) return 0;
     
     simfs_entry_t *entry = find_entry_any(full_path);
     if (entry) {
@@ -232,7 +226,7 @@ int simfs_exists(const char *name, simfs_type_t *type) {
 
 int simfs_read_file(const char *name, char *buffer, uint32_t max_size) {
     char full_path[SIMFS_MAX_PATH];
-    simfs_resolve_path(name, full_path);
+    if (!simfs_resolve_path(name, full_path)) return -1;
     
     simfs_entry_t *entry = find_entry(full_path, SIMFS_TYPE_FILE);
     if (!entry) {
@@ -249,7 +243,7 @@ int simfs_read_file(const char *name, char *buffer, uint32_t max_size) {
 
 int simfs_write_file(const char *name, const char *content) {
     char full_path[SIMFS_MAX_PATH];
-    simfs_resolve_path(name, full_path);
+    if (!simfs_resolve_path(name, full_path)) return -1;
     
     simfs_entry_t *entry = find_entry(full_path, SIMFS_TYPE_FILE);
     if (!entry) {
@@ -277,7 +271,7 @@ int simfs_list_dir(const char *path, char names[][SIMFS_MAX_NAME], simfs_type_t
         if (!entries[i].in_use) continue;
         
         if (path_equals(entries[i].parent_path, search_path)) {
-            strcpy(names[count], entries[i].name);
+            strlcpy(names[count], entries[i].name, SIMFS_MAX_NAME);
             types[count] = entries[i].type;
             count++;
         }
@@ -307,3 +301,39 @@ int simfs_get_file_count(void) {
     }
     return count;
 }
+
+static void file_stream_write(stream_t *stream, const char *data, size_t len) {
+    simfs_stream_t *file = stream->ctx;
+    uint32_t room = SIMFS_MAX_CONTENT - 1 - file->len;
+    if (len > room) {
+        len = room;
+        stream->error = true;
+    }
+    memcpy(file->content + file->len, data, len);
+    file->len += len;
+    file->content[file->len] = '\0';
+}
+
+static void file_stream_sync(stream_t *stream) {
+    simfs_stream_t *file = stream->ctx;
+    if (simfs_write_file(file->path, file->content) != 0) stream->error = true;
+}
+
+int simfs_open_stream(simfs_stream_t *file, const char *name, bool append) {
+    if (!simfs_resolve_path(name, file->path)) return -1;
+    if (find_entry(file->path, SIMFS_TYPE_DIR)) return -1;
+
+    file->len = 0;
+    file->content[0] = '\0';
+    if (append) {
+        simfs_entry_t *entry = find_entry(file->path, SIMFS_TYPE_FILE);
+        if (entry) file->len = strlcpy(file->content, entry->content, SIMFS_MAX_CONTENT);
+    }
+    // Created by name like touch does; later flushes find it by path
+    if (simfs_write_file(name, file->content) != 0) return -1;
+
+    // The content buffer already batches everything, so no stream buffer
+    stream_init(&file->stream, file_stream_write, file, NULL, 0, STREAM_FULL);
+    file->stream.sync = file_stream_sync;
+    return 0;
+}
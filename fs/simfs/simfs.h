@@ -6,6 +6,7 @@
 #define SIMFS_H
 
 #include "../../include/types.h"
+#include "../../lib/stdio/stdio.h"
 
 #define SIMFS_MAX_FILES 64
 #define SIMFS_MAX_DIRS 32
@@ -52,4 +53,17 @@ int simfs_get_file_count(void);
 
 char* simfs_resolve_path(const char *name, char *full_path);
 
+// Output stream into a file. The text collects in content and each
+// fflush() stores all of it; anything past SIMFS_MAX_CONTENT is dropped
+// and flags the stream. The path is resolved once, at open.
+typedef struct {
+    stream_t stream;
+    char path[SIMFS_MAX_PATH];
+    char content[SIMFS_MAX_CONTENT];
+    uint32_t len;
+} simfs_stream_t;
+
+// Truncates the file (creating it if needed) unless append is set.
+int simfs_open_stream(simfs_stream_t *file, const char *name, bool append);
+
 #endif
@@ -0,0 +1,27 @@
+/* ================================================
+ * kernel/arena.c - Bump-pointer scratch arenas
+ * ================================================ */
+#include "arena.h"
+#include "memory.h"
+
+bool arena_init(arena_t *arena, size_t size) {
+    // The heap commits pages on first touch, so an unused tail costs nothing
+    arena->base = (uint8_t*)kmalloc(size);
+    arena->size = arena->base ? size : 0;
+    arena->used = 0;
+    arena->peak = 0;
+    return arena->base != NULL;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    size_t offset = (arena->used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (size > arena->size || offset > arena->size - size) return NULL;
+
+    arena->used = offset + size;
+    if (arena->used > arena->peak) arena->peak = arena->used;
+    return arena->base + offset;
+}
+
+void arena_reset(arena_t *arena) {
+    arena->used = 0;
+}
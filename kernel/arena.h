@@ -0,0 +1,21 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "../include/types.h"
+
+#define ARENA_ALIGN 16
+
+// Bump-pointer scratch space: allocations are never freed one by one,
+// the whole arena is released in one step with arena_reset.
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t peak;
+} arena_t;
+
+bool arena_init(arena_t *arena, size_t size);
+void *arena_alloc(arena_t *arena, size_t size);
+void arena_reset(arena_t *arena);
+
+#endif
@@ -0,0 +1,131 @@
+/* ================================================
+ * kernel/cpu.c - CPUID feature detection
+ * ================================================ */
+#include "cpu.h"
+#include "fpu.h"
+#include "klog.h"
+#include "../lib/string/string.h"
+
+#define EFLAGS_ID (1 << 21)
+
+// CPUID leaf 1, EDX
+#define CPUID1_EDX_FPU  (1 << 0)
+#define CPUID1_EDX_TSC  (1 << 4)
+#define CPUID1_EDX_APIC (1 << 9)
+#define CPUID1_EDX_FXSR (1 << 24)
+#define CPUID1_EDX_SSE  (1 << 25)
+#define CPUID1_EDX_SSE2 (1 << 26)
+
+// CPUID leaf 7 subleaf 0, EBX
+#define CPUID7_EBX_ERMS (1 << 9)
+
+static cpu_info_t cpu_info;
+
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+    __asm__ volatile("cpuid"
+                     : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+                     : "a"(leaf), "c"(subleaf));
+}
+
+// The ID flag in EFLAGS can only be toggled on CPUs that implement CPUID.
+static bool cpuid_supported(void) {
+    uint32_t before, after;
+    __asm__ volatile("pushfl\n\t"
+                     "pushfl\n\t"
+                     "popl %0\n\t"
+                     "movl %0, %1\n\t"
+                     "xorl %2, %1\n\t"
+                     "pushl %1\n\t"
+                     "popfl\n\t"
+                     "pushfl\n\t"
+                     "popl %1\n\t"
+                     "popfl"
+                     : "=&r"(before), "=&r"(after)
+                     : "i"(EFLAGS_ID));
+    return ((before ^ after) & EFLAGS_ID) != 0;
+}
+
+static void read_brand(void) {
+    uint32_t regs[4];
+    cpuid(0x80000000, 0, regs);
+    if (regs[0] < 0x80000004) return;
+
+    for (uint32_t leaf = 0; leaf < 3; leaf++) {
+        cpuid(0x80000002 + leaf, 0, regs);
+        memcpy(&cpu_info.brand[leaf * 16], regs, 16);
+    }
+    cpu_info.brand[48] = '\0';
+
+    // Brand strings are often right-aligned with leading spaces
+    int start = 0;
+    while (cpu_info.brand[start] == ' ') start++;
+    if (start) memmove(cpu_info.brand, &cpu_info.brand[start], strlen(&cpu_info.brand[start]) + 1);
+}
+
+static void cpu_detect(void) {
+    uint32_t regs[4];
+
+    cpu_info.has_cpuid = cpuid_supported();
+    if (!cpu_info.has_cpuid) {
+        strcpy(cpu_info.vendor, "unknown");
+        return;
+    }
+
+    cpuid(0, 0, regs);
+    uint32_t max_leaf = regs[0];
+    memcpy(&cpu_info.vendor[0], &regs[1], 4);     // EBX, EDX, ECX order
+    memcpy(&cpu_info.vendor[4], &regs[3], 4);
+    memcpy(&cpu_info.vendor[8], &regs[2], 4);
+    cpu_info.vendor[12] = '\0';
+
+    if (max_leaf >= 1) {
+        cpuid(1, 0, regs);
+        uint32_t family = (regs[0] >> 8) & 0xF;
+        uint32_t model = (regs[0] >> 4) & 0xF;
+        if (family == 0xF) family += (regs[0] >> 20) & 0xFF;
+        if (family == 0x6 || family >= 0xF) model |= ((regs[0] >> 16) & 0xF) << 4;
+        cpu_info.family = family;
+        cpu_info.model = model;
+        cpu_info.stepping = regs[0] & 0xF;
+
+        uint32_t edx = regs[3];
+        if (edx & CPUID1_EDX_FPU) cpu_info.features |= CPU_FEATURE_FPU;
+        if (edx & CPUID1_EDX_TSC) cpu_info.features |= CPU_FEATURE_TSC;
+        if (edx & CPUID1_EDX_APIC) cpu_info.features |= CPU_FEATURE_APIC;
+        if (edx & CPUID1_EDX_FXSR) cpu_info.features |= CPU_FEATURE_FXSR;
+        if (edx & CPUID1_EDX_SSE) cpu_info.features |= CPU_FEATURE_SSE;
+        if (edx & CPUID1_EDX_SSE2) cpu_info.features |= CPU_FEATURE_SSE2;
+    }
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, regs);
+        if (regs[1] & CPUID7_EBX_ERMS) cpu_info.features |= CPU_FEATURE_ERMS;
+    }
+
+    read_brand();
+}
+
+void cpu_init(void) {
+    cpu_detect();
+    fpu_init();
+
+    uint32_t caps = 0;
+    if (cpu_has(CPU_FEATURE_ERMS)) caps |= STRING_CAP_ERMS;
+    if (cpu_has(CPU_FEATURE_SSE2) && fpu_sse_enabled()) caps |= STRING_CAP_SSE2;
+    string_select(caps);
+
+    string_impls_t impls;
+    string_get_impls(&impls);
+    klog(KLOG_INFO, "cpu: %s %s, family %u model %u stepping %u",
+         cpu_info.vendor, cpu_info.brand, cpu_info.family, cpu_info.model, cpu_info.stepping);
+    klog(KLOG_INFO, "cpu: features %#x, memcpy %s, memchr %s",
+         cpu_info.features, impls.memcpy, impls.memchr);
+}
+
+const cpu_info_t *cpu_get_info(void) {
+    return &cpu_info;
+}
+
+bool cpu_has(uint32_t feature) {
+    return (cpu_info.features & feature) == feature;
+}
@@ -0,0 +1,30 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "../include/types.h"
+
+#define CPU_FEATURE_FPU  (1 << 0)
+#define CPU_FEATURE_TSC  (1 << 1)
+#define CPU_FEATURE_APIC (1 << 2)
+#define CPU_FEATURE_FXSR (1 << 3)
+#define CPU_FEATURE_SSE  (1 << 4)
+#define CPU_FEATURE_SSE2 (1 << 5)
+#define CPU_FEATURE_ERMS (1 << 6)   // Fast rep movsb/stosb
+
+typedef struct {
+    bool has_cpuid;
+    char vendor[13];
+    char brand[49];
+    uint32_t family;
+    uint32_t model;
+    uint32_t stepping;
+    uint32_t features;      // CPU_FEATURE_* bits
+} cpu_info_t;
+
+// Probes the CPU, enables the FPU/SSE and points lib/string at the best
+// routines the CPU supports.
+void cpu_init(void);
+const cpu_info_t *cpu_get_info(void);
+bool cpu_has(uint32_t feature);
+
+#endif
@@ -0,0 +1,124 @@
+/* ================================================
+ * kernel/fpu.c - x87/SSE enable and lazy context save
+ * ================================================ */
+#include "fpu.h"
+#include "cpu.h"
+#include "irq.h"
+#include "kernel.h"
+
+#define CR0_MP (1 << 1)
+#define CR0_EM (1 << 2)
+#define CR0_TS (1 << 3)
+#define CR0_NE (1 << 5)
+#define CR4_OSFXSR     (1 << 9)
+#define CR4_OSXMMEXCPT (1 << 10)
+
+#define FPU_STATE_SIZE 512      // FXSAVE image; FNSAVE needs only 108
+#define NM_VECTOR 7
+
+typedef struct {
+    uint8_t state[FPU_STATE_SIZE];
+    bool saved;                 // State of the interrupted context is here
+    bool ts_on_entry;
+} __attribute__((aligned(16))) fpu_frame_t;
+
+static fpu_frame_t frames[FPU_MAX_DEPTH + 1];
+static int depth = 0;
+static bool fpu_enabled = false;
+static bool fxsr_enabled = false;
+static uint32_t lazy_saves = 0;
+
+static inline uint32_t read_cr0(void) {
+    uint32_t cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    return cr0;
+}
+
+static inline void write_cr0(uint32_t cr0) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0));
+}
+
+static inline void clts(void) {
+    __asm__ volatile("clts");
+}
+
+// #NM: the current handler wants the FPU while the registers still hold
+// the interrupted context's values. Park those before handing it over.
+static void device_not_available_handler(registers_t *regs) {
+    (void)regs;
+    clts();
+    if (depth == 0) return;
+
+    fpu_frame_t *frame = &frames[depth];
+    if (frame->saved) return;
+    if (fxsr_enabled) {
+        __asm__ volatile("fxsave %0" : "=m"(frame->state));
+    } else {
+        __asm__ volatile("fnsave %0" : "=m"(frame->state));
+    }
+    __asm__ volatile("fninit");
+    frame->saved = true;
+    lazy_saves++;
+}
+
+void fpu_init(void) {
+    if (!cpu_has(CPU_FEATURE_FPU)) return;
+
+    uint32_t cr0 = read_cr0();
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    write_cr0(cr0);
+    __asm__ volatile("fninit");
+
+    if (cpu_has(CPU_FEATURE_FXSR | CPU_FEATURE_SSE)) {
+        uint32_t cr4;
+        __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+        cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+        __asm__ volatile("mov %0, %%cr4" : : "r"(cr4));
+        fxsr_enabled = true;
+    }
+
+    isr_install_handler(NM_VECTOR, device_not_available_handler);
+    fpu_enabled = true;
+}
+
+bool fpu_sse_enabled(void) {
+    return fxsr_enabled;
+}
+
+uint32_t fpu_lazy_saves(void) {
+    return lazy_saves;
+}
+
+void fpu_interrupt_enter(void) {
+    if (!fpu_enabled) return;
+    if (depth == FPU_MAX_DEPTH) {
+        kernel_panic("fpu: interrupt nesting too deep");
+    }
+
+    fpu_frame_t *frame = &frames[++depth];
+    uint32_t cr0 = read_cr0();
+    frame->saved = false;
+    frame->ts_on_entry = (cr0 & CR0_TS) != 0;
+    if (!frame->ts_on_entry) write_cr0(cr0 | CR0_TS);
+}
+
+void fpu_interrupt_exit(void) {
+    if (!fpu_enabled || depth == 0) return;
+
+    fpu_frame_t *frame = &frames[depth--];
+    uint32_t cr0 = read_cr0();
+    if (frame->saved) {
+        clts();
+        cr0 &= ~CR0_TS;
+        if (fxsr_enabled) {
+            __asm__ volatile("fxrstor %0" : : "m"(frame->state));
+        } else {
+            __asm__ volatile("frstor %0" : : "m"(frame->state));
+        }
+    }
+
+    // Hand back ownership exactly as the interrupted context left it
+    uint32_t restored = frame->ts_on_entry ? (cr0 | CR0_TS) : (cr0 & ~CR0_TS);
+    if (restored != cr0) write_cr0(restored);
+}
@@ -0,0 +1,20 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include "../include/types.h"
+
+// Deepest interrupt/exception nesting that can hold saved SIMD state.
+#define FPU_MAX_DEPTH 4
+
+// Enables x87 and, when the CPU has FXSR and SSE, SSE state.
+void fpu_init(void);
+bool fpu_sse_enabled(void);
+uint32_t fpu_lazy_saves(void);
+
+// Bracket every interrupt and exception handler. Entry only sets CR0.TS;
+// the interrupted context's registers are saved by the #NM handler the
+// first time the handler actually touches the FPU or SSE.
+void fpu_interrupt_enter(void);
+void fpu_interrupt_exit(void);
+
+#endif
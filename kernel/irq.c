@@ -1,7 +1,9 @@
 #include "irq.h"
 #include "kernel.h"
+#include "fpu.h"
 
 static irq_handler_t irq_handlers[16] = {0};
+static isr_handler_t isr_handlers[32] = {0};
 
 static void pic_remap(void) {
     // ICW1
@@ -36,7 +38,14 @@ void irq_install_handler(int irq, irq_handler_t handler) {
     }
 }
 
+void isr_install_handler(int isr, isr_handler_t handler) {
+    if (isr >= 0 && isr < 32) {
+        isr_handlers[isr] = handler;
+    }
+}
+
 void irq_handler(registers_t *regs) {
+    fpu_interrupt_enter();
     if (regs->int_no >= 32 && regs->int_no <= 47) {
         int irq = regs->int_no - 32;
         if (irq_handlers[irq]) {
@@ -48,8 +57,15 @@ void irq_handler(registers_t *regs) {
         outb(0xA0, 0x20);
     }
     outb(0x20, 0x20);
+    fpu_interrupt_exit();
 }
 
 void isr_handler(registers_t *regs) {
-    (void)regs;
+    // #NM is the lazy FPU switch itself and must see the caller's depth
+    bool track_fpu = regs->int_no != 7;
+    if (track_fpu) fpu_interrupt_enter();
+    if (regs->int_no < 32 && isr_handlers[regs->int_no]) {
+        isr_handlers[regs->int_no](regs);
+    }
+    if (track_fpu) fpu_interrupt_exit();
 }
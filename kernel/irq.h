@@ -14,8 +14,10 @@ typedef struct {
 } registers_t;
 
 typedef void (*irq_handler_t)(registers_t *);
+typedef void (*isr_handler_t)(registers_t *);
 
 void irq_init(void);
 void irq_install_handler(int irq, irq_handler_t handler);
+void isr_install_handler(int isr, isr_handler_t handler);
 
 #endif
@@ -2,7 +2,12 @@
 #include "idt.h"
 #include "irq.h"
 #include "timer.h"
+#include "cpu.h"
+#include "klog.h"
 #include "memory.h"
+#include "pmm.h"
+#include "paging.h"
+#include "multiboot.h"
 #include "../drivers/vga/vga.h"
 #include "../drivers/keyboard/keyboard.h"
 #include "../drivers/serial/serial.h"
@@ -19,13 +24,18 @@
 #define STEP_DELAY_MS 4000
 #define SHOW_BOOT_LOGO 1
 
+static multiboot_info_t *boot_info = NULL;
+
 void kernel_panic(const char *message) {
     cli();
+    klog(KLOG_ERR, "panic: %s", message);
+    klog_flush();
     vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
     vga_clear();
     printf("\n\n  KERNEL PANIC!\n");
     printf("  %s\n\n", message);
     printf("  System halted.\n");
+    vga_flush();
     for(;;) hlt();
 }
 
@@ -54,10 +64,12 @@ static void show_boot_logo(void) {
 
 static void boot_step(const char *message, void (*init_func)(void), bool with_delay) {
     printf("[ .. ] %s", message);
+    vga_flush();
     
     if (init_func) {
         init_func();
     }
+    klog(KLOG_INFO, "%s", message);
     
     if (with_delay) {
         simple_delay(STEP_DELAY_MS);
@@ -69,9 +81,23 @@ static void boot_step(const char *message, void (*init_func)(void), bool with_de
     printf(" %s\n", message);
 }
 
+static void init_cpu_wrapper(void) { cpu_init(); }
 static void init_idt_wrapper(void) { idt_init(); }
 static void init_irq_wrapper(void) { irq_init(); }
 static void init_timer_wrapper(void) { timer_init(100); }
+static void init_serial_wrapper(void) {
+    serial_init();
+    klog_init();
+#ifdef SERIAL_MIRROR
+    // Headless boots: start with the screen mirrored to COM1
+    if (serial_present()) {
+        klog_set_serial(false);
+        vga_mirror_enable(true);
+    }
+#endif
+}
+static void init_pmm_wrapper(void) { pmm_init(boot_info); }
+static void init_paging_wrapper(void) { paging_init(); }
 static void init_memory_wrapper(void) { memory_init(); }
 static void init_keyboard_wrapper(void) { keyboard_init(); }
 static void init_rtc_wrapper(void) { rtc_init(); }
@@ -88,7 +114,7 @@ static void init_filesystems_wrapper(void) {
 }
 
 void kernel_main(uint32_t magic, uint32_t addr) {
-    (void)addr;
+    boot_info = (multiboot_info_t*)addr;
     
     vga_init();
     vga_clear();
@@ -103,9 +129,13 @@ void kernel_main(uint32_t magic, uint32_t addr) {
     printf("Booting LexOS v%s...\n\n", KERNEL_VERSION_STRING);
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     
+    boot_step("Detecting CPU...", init_cpu_wrapper, true);
     boot_step("Initializing IDT...", init_idt_wrapper, true);
     boot_step("Initializing IRQ...", init_irq_wrapper, true);
     boot_step("Starting timer...", init_timer_wrapper, true);
+    boot_step("Initializing serial log...", init_serial_wrapper, true);
+    boot_step("Detecting physical memory...", init_pmm_wrapper, true);
+    boot_step("Enabling paging...", init_paging_wrapper, true);
     boot_step("Initializing memory...", init_memory_wrapper, true);
     boot_step("Initializing keyboard...", init_keyboard_wrapper, true);
     boot_step("Initializing RTC...", init_rtc_wrapper, true);
@@ -122,6 +152,7 @@ void kernel_main(uint32_t magic, uint32_t addr) {
     int countdown = BOOT_DELAY_MS / 1000;
     for (int i = countdown; i > 0; i--) {
         printf("%d... ", i);
+        vga_flush();
         simple_delay(1000);
     }
     printf("\n\n");
@@ -5,8 +5,8 @@ bits 32
 section .multiboot
 align 4
     dd 0x1BADB002            ; Magic number
-    dd 0x00                   ; Flags
-    dd -(0x1BADB002 + 0x00)  ; Checksum
+    dd 0x02                   ; Flags: request memory map
+    dd -(0x1BADB002 + 0x02)  ; Checksum
 
 section .text.entry
 global kernel_entry
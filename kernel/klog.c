@@ -0,0 +1,171 @@
+/* ================================================
+ * kernel/klog.c - Kernel log ring buffer
+ * ================================================ */
+#include "klog.h"
+#include "timer.h"
+#include "kernel.h"
+#include "../drivers/serial/serial.h"
+#include "../lib/string/string.h"
+
+#define EFLAGS_IF (1 << 9)
+#define SLOT(seq) ((seq) & (KLOG_ENTRIES - 1))
+#define SEQ_WRITING 0xFFFFFFFF
+
+// One writer at a time is guaranteed by masking interrupts around the
+// append; readers never block it and detect overwrites by sequence.
+static klog_entry_t ring[KLOG_ENTRIES];
+static volatile uint32_t next_seq = 0;
+
+// Serial drain state: the message being sent and how far it got
+static uint32_t drain_seq = 0;
+static char drain_line[KLOG_TEXT_LEN + 32];
+static size_t drain_len = 0;
+static size_t drain_pos = 0;
+static bool drain_enabled = true;
+
+static const char *level_names[] = { "err", "warn", "info", "debug" };
+
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (flags & EFLAGS_IF) __asm__ volatile("sti" : : : "memory");
+}
+
+static void entry_sink(void *ctx, const char *data, size_t len) {
+    klog_entry_t *entry = ctx;
+    size_t room = KLOG_TEXT_LEN - 1 - entry->len;
+    if (len > room) len = room;
+    memcpy(entry->text + entry->len, data, len);
+    entry->len += len;
+}
+
+void klog_init(void) {
+    serial_set_tx_handler(klog_pump);
+}
+
+void vklog(int level, const char *format, va_list args) {
+    uint32_t flags = irq_save();
+    uint32_t seq = next_seq;
+    klog_entry_t *entry = &ring[SLOT(seq)];
+
+    entry->seq = SEQ_WRITING;
+    __asm__ volatile("" : : : "memory");
+    entry->ticks = timer_get_ticks();
+    entry->level = level < 0 ? 0 : (level > KLOG_DEBUG ? KLOG_DEBUG : level);
+    entry->len = 0;
+    vsinkprintf(entry_sink, entry, format, args);
+    entry->text[entry->len] = '\0';
+    __asm__ volatile("" : : : "memory");
+    entry->seq = seq;
+    next_seq = seq + 1;
+    irq_restore(flags);
+}
+
+void klog(int level, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vklog(level, format, args);
+    va_end(args);
+}
+
+const char *klog_level_name(int level) {
+    return level_names[level & 3];
+}
+
+uint32_t klog_first_seq(void) {
+    uint32_t next = next_seq;
+    return next > KLOG_ENTRIES ? next - KLOG_ENTRIES : 0;
+}
+
+uint32_t klog_next_seq(void) {
+    return next_seq;
+}
+
+bool klog_read(uint32_t seq, klog_entry_t *entry) {
+    const klog_entry_t *slot = &ring[SLOT(seq)];
+    if (slot->seq != seq) return false;
+    *entry = *slot;
+    __asm__ volatile("" : : : "memory");
+    // A writer may have reused the slot while it was being copied
+    return slot->seq == seq;
+}
+
+// Formats the next message into drain_line; false when none is pending.
+static bool drain_next(void) {
+    klog_entry_t entry;
+    while (drain_seq != next_seq) {
+        if (drain_seq < klog_first_seq()) drain_seq = klog_first_seq();
+        if (klog_read(drain_seq++, &entry)) {
+            uint32_t hz = timer_get_frequency();
+            uint32_t secs = hz ? entry.ticks / hz : 0;
+            uint32_t hundredths = hz ? (entry.ticks % hz) * 100 / hz : 0;
+            drain_len = snprintf(drain_line, sizeof(drain_line), "[%5u.%02u] %s: %s\r\n",
+                                 secs, hundredths, klog_level_name(entry.level), entry.text);
+            if (drain_len >= sizeof(drain_line)) drain_len = sizeof(drain_line) - 1;
+            drain_pos = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs with interrupts off (timer or serial IRQ), so it never races itself.
+void klog_pump(void) {
+    if (!drain_enabled || !serial_tx_empty()) return;
+
+    size_t room = SERIAL_FIFO_SIZE;
+    while (room) {
+        if (drain_pos == drain_len && !drain_next()) break;
+        size_t sent = serial_fill_fifo(drain_line + drain_pos,
+                                       drain_len - drain_pos < room ? drain_len - drain_pos : room);
+        drain_pos += sent;
+        room -= sent;
+    }
+
+    // Let the UART call back as soon as the FIFO empties while there is
+    // more to send; otherwise the next timer tick picks it up.
+    serial_enable_tx_irq(drain_pos != drain_len || drain_seq != next_seq);
+}
+
+void klog_set_serial(bool enabled) {
+    uint32_t flags = irq_save();
+    drain_enabled = enabled;
+    if (enabled) serial_set_tx_handler(klog_pump);
+    irq_restore(flags);
+}
+
+void klog_flush(void) {
+    // Whoever turned the drain off owns the port; the ring keeps the rest
+    if (!drain_enabled || !serial_present()) return;
+    uint32_t flags = irq_save();
+    serial_write(drain_line + drain_pos, drain_len - drain_pos);
+    drain_pos = drain_len;
+    while (drain_next()) {
+        serial_write(drain_line, drain_len);
+        drain_pos = drain_len;
+    }
+    irq_restore(flags);
+}
+
+static void serial_stream_write(stream_t *stream, const char *data, size_t len) {
+    uint32_t flags = irq_save();
+    if (!drain_enabled) {
+        // The port is lent out; interleaving would corrupt its stream
+        stream->error = true;
+        irq_restore(flags);
+        return;
+    }
+    klog_flush();
+    serial_write(data, len);
+    irq_restore(flags);
+}
+
+static char serial_buf[128];
+static stream_t serial_stream = {
+    serial_stream_write, NULL, NULL, serial_buf, sizeof(serial_buf), 0, STREAM_LINE, false
+};
+stream_t *serial_out = &serial_stream;
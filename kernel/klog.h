@@ -0,0 +1,50 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+#include "../include/types.h"
+#include "../lib/stdio/stdio.h"
+
+#define KLOG_ERR   0
+#define KLOG_WARN  1
+#define KLOG_INFO  2
+#define KLOG_DEBUG 3
+
+#define KLOG_ENTRIES 256        // Power of two
+#define KLOG_TEXT_LEN 116       // Keeps an entry at 128 bytes
+
+typedef struct {
+    uint32_t seq;               // Which message this slot holds
+    uint32_t ticks;             // Timer ticks when it was logged
+    uint8_t level;
+    uint8_t len;
+    char text[KLOG_TEXT_LEN];
+} klog_entry_t;
+
+void klog_init(void);
+void klog(int level, const char *format, ...);
+void vklog(int level, const char *format, va_list args);
+const char *klog_level_name(int level);
+
+// Readers walk sequence numbers from klog_first_seq() up to
+// klog_next_seq(). klog_read returns false for a message that has
+// already been overwritten.
+uint32_t klog_first_seq(void);
+uint32_t klog_next_seq(void);
+bool klog_read(uint32_t seq, klog_entry_t *entry);
+
+// Moves pending messages to the serial FIFO without waiting; called
+// from the timer tick. klog_flush waits for everything (panic path).
+// Both do nothing while the drain is stopped.
+void klog_pump(void);
+void klog_flush(void);
+
+// Stops or resumes the serial drain, for when something else needs the
+// port. Messages still collect in the ring and go out on resume.
+void klog_set_serial(bool enabled);
+
+// Plain line-buffered output on the log's serial port. Pending log
+// messages go out first so the two never interleave mid-line. Output is
+// dropped, and the stream's error set, while the drain is stopped.
+extern stream_t *serial_out;
+
+#endif
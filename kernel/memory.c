@@ -2,71 +2,616 @@
  * kernel/memory.c
  * ================================================ */
 #include "memory.h"
+#include "paging.h"
 #include "kernel.h"
+#include "../lib/string/string.h"
 
-#define HEAP_SIZE 0x100000  // 1MB
+#define HEAP_INITIAL_SIZE 0x100000  // 1MB of address space, committed lazily
+#define HEAP_GROW_MIN 0x10000  // Extend the heap window 64 KB at a time
+#define CLASS_CHUNK_SIZE 0x4000     // Size and alignment of a class chunk
+#define MEM_CLASS_CHUNK 0xFE        // size_class of the block holding a chunk
 
-static uint8_t heap[HEAP_SIZE] __attribute__((aligned(16)));
-static mem_block_t *first_block = NULL;
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((a) - 1))
+#define BLOCK_OVERHEAD (sizeof(mem_block_t) + sizeof(mem_footer_t))
+#define MIN_BLOCK_SIZE ALIGN_UP(BLOCK_OVERHEAD + MEM_ALIGN, MEM_ALIGN)
+
+// Free blocks are binned by size: four bins per power of two, so every
+// block in a bin is within 25% of the others. A bitmap marks the bins
+// that hold anything.
+#define BIN_SPLIT_SHIFT 2
+#define NUM_BINS (32 << BIN_SPLIT_SHIFT)
+
+// A region is a contiguous stretch of heap. Its prologue footer points at
+// a permanently used sentinel and it ends with a zero-sized used epilogue
+// header, so coalescing never walks off either end.
+typedef struct mem_region {
+    struct mem_region *next;
+    size_t size;
+    uint32_t reserved;
+    mem_footer_t prologue;
+} mem_region_t;
+
+static mem_block_t heap_sentinel;
+static mem_region_t *regions = NULL;
+static mem_block_t *free_bins[NUM_BINS];
+static uint32_t bin_map[NUM_BINS / 32];
+static uint32_t heap_total = 0;
+static uint32_t heap_overhead = 0;   // Region headers and epilogues
+static mem_telemetry_t telemetry;
 static bool memory_initialized = false;
 
+// Size-class objects are carved from chunks: aligned general blocks that
+// hold objects of one class only, so small objects never sit between
+// large blocks and stop them merging. Objects have a header but no
+// footer, and find their chunk by masking their address. A chunk goes
+// back to the general heap once all its objects are free.
+typedef struct class_chunk {
+    struct class_chunk *prev;
+    struct class_chunk *next;     // Chunks of the class with free objects
+    mem_block_t *free;            // Free objects, chained through next_free
+    uint32_t live;
+} class_chunk_t;
+
+#define CHUNK_OBJECTS_OFFSET ALIGN_UP(sizeof(class_chunk_t), MEM_ALIGN)
+
+static class_chunk_t *class_partial[MEM_NUM_CLASSES];
+static class_chunk_t *class_spare[MEM_NUM_CLASSES];    // At most one empty chunk
+static mem_class_stats_t class_stats[MEM_NUM_CLASSES];
+
+static mem_footer_t *block_footer(mem_block_t *block) {
+    return (mem_footer_t*)((uint8_t*)block + block->size) - 1;
+}
+
+static mem_block_t *block_next(mem_block_t *block) {
+    return (mem_block_t*)((uint8_t*)block + block->size);
+}
+
+static mem_block_t *block_prev(mem_block_t *block) {
+    return ((mem_footer_t*)block - 1)->header;
+}
+
+static void *block_payload(mem_block_t *block) {
+    return (uint8_t*)block + sizeof(mem_block_t);
+}
+
+static mem_block_t *payload_block(void *ptr) {
+    return (mem_block_t*)((uint8_t*)ptr - sizeof(mem_block_t));
+}
+
+static void set_block(mem_block_t *block, size_t size, bool used) {
+    block->size = size;
+    block->used = used;
+    block->cached = false;
+    block->size_class = MEM_CLASS_NONE;
+    block_footer(block)->header = block;
+}
+
+static int bin_index(size_t size) {
+    int top = 31 - __builtin_clz(size);
+    return (top << BIN_SPLIT_SHIFT) |
+           ((size >> (top - BIN_SPLIT_SHIFT)) & ((1 << BIN_SPLIT_SHIFT) - 1));
+}
+
+static void free_list_insert(mem_block_t *block) {
+    int bin = bin_index(block->size);
+    block->prev_free = NULL;
+    block->next_free = free_bins[bin];
+    if (free_bins[bin]) free_bins[bin]->prev_free = block;
+    free_bins[bin] = block;
+    bin_map[bin / 32] |= 1u << (bin % 32);
+}
+
+static void free_list_remove(mem_block_t *block) {
+    int bin = bin_index(block->size);
+    if (block->prev_free) block->prev_free->next_free = block->next_free;
+    else free_bins[bin] = block->next_free;
+    if (block->next_free) block->next_free->prev_free = block->prev_free;
+    if (!free_bins[bin]) bin_map[bin / 32] &= ~(1u << (bin % 32));
+}
+
+static void heap_add_region(void *start, size_t size) {
+    mem_region_t *region = (mem_region_t*)start;
+    region->size = size;
+    region->next = regions;
+    region->prologue.header = &heap_sentinel;
+    regions = region;
+
+    mem_block_t *block = (mem_block_t*)(region + 1);
+    size_t block_size = size - sizeof(mem_region_t) - sizeof(mem_block_t);
+    set_block(block, block_size, false);
+
+    mem_block_t *epilogue = block_next(block);
+    epilogue->size = 0;
+    epilogue->used = true;
+    epilogue->cached = false;
+
+    free_list_insert(block);
+    heap_total += size;
+    heap_overhead += sizeof(mem_region_t) + sizeof(mem_block_t);
+}
+
 void memory_init(void) {
-    first_block = (mem_block_t*)heap;
-    first_block->size = HEAP_SIZE - sizeof(mem_block_t);
-    first_block->used = false;
-    first_block->next = NULL;
+    heap_sentinel.size = 0;
+    heap_sentinel.used = true;
+    regions = NULL;
+    memset(free_bins, 0, sizeof(free_bins));
+    memset(bin_map, 0, sizeof(bin_map));
+    heap_total = 0;
+    heap_overhead = 0;
+    memset(&telemetry, 0, sizeof(telemetry));
+
+    for (int i = 0; i < MEM_NUM_CLASSES; i++) {
+        class_partial[i] = NULL;
+        class_spare[i] = NULL;
+        class_stats[i].size = 1 << (MEM_MIN_CLASS_SHIFT + i);
+        class_stats[i].allocs = 0;
+        class_stats[i].hits = 0;
+        class_stats[i].cached = 0;
+    }
+
+    void *start = paging_heap_grow(HEAP_INITIAL_SIZE);
+    if (!start) return;
+    heap_add_region(start, HEAP_INITIAL_SIZE);
     memory_initialized = true;
 }
 
+static int size_to_class(size_t size) {
+    if (size <= (1 << MEM_MIN_CLASS_SHIFT)) return 0;
+    return 32 - __builtin_clz(size - 1) - MEM_MIN_CLASS_SHIFT;
+}
+
+// Returns 0 when the request cannot be represented at all.
+static size_t request_block_size(size_t size) {
+    if (size > 0xFFFFFFFF - BLOCK_OVERHEAD - MEM_ALIGN) return 0;
+    size_t block_size = ALIGN_UP(size + BLOCK_OVERHEAD, MEM_ALIGN);
+    return block_size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : block_size;
+}
+
+// Best fit within the request's own bin, where some blocks may still be
+// too small; past that, any block of the next non-empty bin fits and is
+// at most a bin's width bigger than needed.
 static mem_block_t *find_free_block(size_t size) {
-    mem_block_t *current = first_block;
-    while (current) {
-        if (!current->used && current->size >= size) {
-            return current;
+    int bin = bin_index(size);
+    mem_block_t *best = NULL;
+    for (mem_block_t *current = free_bins[bin]; current; current = current->next_free) {
+        if (current->size >= size && (!best || current->size < best->size)) {
+            best = current;
+            if (best->size == size) break;
         }
-        current = current->next;
+    }
+    if (best) return best;
+
+    bin++;
+    for (int word = bin / 32; word < NUM_BINS / 32; word++) {
+        uint32_t bits = bin_map[word];
+        if (word == bin / 32) bits &= ~0u << (bin % 32);
+        if (bits) return free_bins[word * 32 + __builtin_ctz(bits)];
     }
     return NULL;
 }
 
 static void split_block(mem_block_t *block, size_t size) {
-    if (block->size >= size + sizeof(mem_block_t) + 16) {
-        mem_block_t *new_block = (mem_block_t*)((uint8_t*)block + sizeof(mem_block_t) + size);
-        new_block->size = block->size - size - sizeof(mem_block_t);
-        new_block->used = false;
-        new_block->next = block->next;
-        block->size = size;
-        block->next = new_block;
+    if (block->size - size >= MIN_BLOCK_SIZE) {
+        mem_block_t *rest = (mem_block_t*)((uint8_t*)block + size);
+        set_block(rest, block->size - size, false);
+        set_block(block, size, block->used);
+        free_list_insert(rest);
     }
 }
 
-void *kmalloc(size_t size) {
-    if (!memory_initialized || size == 0) return NULL;
-    size = (size + 3) & ~3;
+// Merges a free block (not on the free list) with free neighbours.
+static mem_block_t *coalesce(mem_block_t *block) {
+    mem_block_t *next = block_next(block);
+    if (!next->used) {
+        free_list_remove(next);
+        set_block(block, block->size + next->size, false);
+    }
+
+    mem_block_t *prev = block_prev(block);
+    if (!prev->used) {
+        free_list_remove(prev);
+        set_block(prev, prev->size + block->size, false);
+        block = prev;
+    }
+    return block;
+}
+
+static void general_free(mem_block_t *block) {
+    block->used = false;
+    block->cached = false;
+    block->size_class = MEM_CLASS_NONE;
+    free_list_insert(coalesce(block));
+}
+
+static void *general_alloc(size_t size) {
     mem_block_t *block = find_free_block(size);
     if (!block) return NULL;
-    split_block(block, size);
+    free_list_remove(block);
     block->used = true;
-    return (void*)((uint8_t*)block + sizeof(mem_block_t));
+    split_block(block, size);
+    return block_payload(block);
+}
+
+static uint32_t class_stride(int cls) {
+    return class_stats[cls].size + sizeof(mem_block_t);
+}
+
+static uint32_t chunk_objects(int cls) {
+    return (CLASS_CHUNK_SIZE - CHUNK_OBJECTS_OFFSET) / class_stride(cls);
+}
+
+static void chunk_list_add(class_chunk_t **list, class_chunk_t *chunk) {
+    chunk->prev = NULL;
+    chunk->next = *list;
+    if (*list) (*list)->prev = chunk;
+    *list = chunk;
+}
+
+static void chunk_list_remove(class_chunk_t **list, class_chunk_t *chunk) {
+    if (chunk->prev) chunk->prev->next = chunk->next;
+    else *list = chunk->next;
+    if (chunk->next) chunk->next->prev = chunk->prev;
+}
+
+static void chunk_release(int cls, class_chunk_t *chunk) {
+    class_stats[cls].cached -= chunk_objects(cls);
+    general_free(payload_block(chunk));
+}
+
+// Gives the spare empty chunks back so they can merge with their
+// neighbours; at most one per class, so this stays cheap.
+static bool release_spare_chunks(void) {
+    bool released = false;
+    for (int i = 0; i < MEM_NUM_CLASSES; i++) {
+        if (class_spare[i]) {
+            chunk_release(i, class_spare[i]);
+            class_spare[i] = NULL;
+            released = true;
+        }
+    }
+    return released;
+}
+
+// Appends bytes to the end of a region. The old epilogue becomes the
+// header of the new free space, which then merges with any free tail.
+static void heap_extend_region(mem_region_t *region, size_t bytes) {
+    mem_block_t *block = (mem_block_t*)((uint8_t*)region + region->size - sizeof(mem_block_t));
+    region->size += bytes;
+    set_block(block, bytes, true);
+
+    mem_block_t *epilogue = block_next(block);
+    epilogue->size = 0;
+    epilogue->used = true;
+    epilogue->cached = false;
+
+    block->used = false;
+    free_list_insert(coalesce(block));
+    heap_total += bytes;
+}
+
+// Reserves more of the heap window. The window is virtually contiguous,
+// so the new range normally just extends the region it follows; frames
+// are committed by the page fault handler as the memory is touched.
+static bool heap_grow(size_t size) {
+    size_t bytes = ALIGN_UP(size + sizeof(mem_region_t) + sizeof(mem_block_t), HEAP_GROW_MIN);
+    uint8_t *addr = (uint8_t*)paging_heap_grow(bytes);
+    if (!addr) return false;
+
+    for (mem_region_t *region = regions; region; region = region->next) {
+        if ((uint8_t*)region + region->size == addr) {
+            heap_extend_region(region, bytes);
+            return true;
+        }
+    }
+    heap_add_region(addr, bytes);
+    return true;
+}
+
+static void *heap_alloc(size_t size) {
+    void *ptr = general_alloc(size);
+    if (!ptr && release_spare_chunks()) {
+        ptr = general_alloc(size);
+    }
+    if (!ptr && heap_grow(size)) {
+        ptr = general_alloc(size);
+    }
+    return ptr;
+}
+
+// Splits the tail off a used general block and gives it back to the heap.
+static void trim_block(mem_block_t *block, size_t size) {
+    if (block->size - size < MIN_BLOCK_SIZE) return;
+    mem_block_t *rest = (mem_block_t*)((uint8_t*)block + size);
+    set_block(rest, block->size - size, true);
+    set_block(block, size, true);
+    general_free(rest);
+}
+
+// Over-allocates a general block and moves the header up to the first
+// aligned payload. The leading gap is always at least MIN_BLOCK_SIZE,
+// so it goes straight back to the free list.
+static mem_block_t *aligned_block(size_t need, size_t align) {
+    void *ptr = heap_alloc(need + align + MIN_BLOCK_SIZE);
+    if (!ptr) return NULL;
+
+    mem_block_t *block = payload_block(ptr);
+    uint32_t payload = (uint32_t)ptr;
+    uint32_t aligned = ALIGN_UP(payload, align);
+    if (aligned != payload && aligned - payload < MIN_BLOCK_SIZE) {
+        aligned += align;
+    }
+    if (aligned != payload) {
+        uint32_t lead = aligned - payload;
+        mem_block_t *moved = payload_block((void*)aligned);
+        set_block(moved, block->size - lead, true);
+        set_block(block, lead, true);
+        general_free(block);
+        block = moved;
+    }
+    trim_block(block, need);
+    return block;
+}
+
+static class_chunk_t *chunk_create(int cls) {
+    mem_block_t *block = aligned_block(request_block_size(CLASS_CHUNK_SIZE), CLASS_CHUNK_SIZE);
+    if (!block) return NULL;
+    block->size_class = MEM_CLASS_CHUNK;
+
+    class_chunk_t *chunk = block_payload(block);
+    chunk->free = NULL;
+    chunk->live = 0;
+
+    // Chain objects so the lowest address is handed out first.
+    uint32_t stride = class_stride(cls);
+    uint8_t *objects = (uint8_t*)chunk + CHUNK_OBJECTS_OFFSET;
+    for (int i = chunk_objects(cls) - 1; i >= 0; i--) {
+        mem_block_t *object = (mem_block_t*)(objects + i * stride);
+        object->size = stride;
+        object->used = true;
+        object->cached = true;
+        object->size_class = (uint8_t)cls;
+        object->next_free = chunk->free;
+        chunk->free = object;
+    }
+    class_stats[cls].cached += chunk_objects(cls);
+    return chunk;
+}
+
+static void *class_alloc(int cls) {
+    mem_class_stats_t *stats = &class_stats[cls];
+    stats->allocs++;
+
+    class_chunk_t *chunk = class_partial[cls];
+    if (!chunk) {
+        chunk = class_spare[cls];
+        class_spare[cls] = NULL;
+        if (!chunk) chunk = chunk_create(cls);
+        else stats->hits++;
+        if (!chunk) return NULL;
+        chunk_list_add(&class_partial[cls], chunk);
+    } else {
+        stats->hits++;
+    }
+
+    mem_block_t *object = chunk->free;
+    chunk->free = object->next_free;
+    chunk->live++;
+    object->cached = false;
+    stats->cached--;
+    if (!chunk->free) chunk_list_remove(&class_partial[cls], chunk);
+    return block_payload(object);
+}
+
+// A chunk that empties becomes the class's spare, and the previous spare,
+// if any, goes back to the general heap.
+static void class_free(mem_block_t *object) {
+    int cls = object->size_class;
+    class_chunk_t *chunk = (class_chunk_t*)((uint32_t)object & ~(CLASS_CHUNK_SIZE - 1));
+    if (!chunk->free) chunk_list_add(&class_partial[cls], chunk);
+
+    object->cached = true;
+    object->next_free = chunk->free;
+    chunk->free = object;
+    chunk->live--;
+    class_stats[cls].cached++;
+
+    if (chunk->live == 0) {
+        chunk_list_remove(&class_partial[cls], chunk);
+        if (class_spare[cls]) chunk_release(cls, class_spare[cls]);
+        class_spare[cls] = chunk;
+    }
+}
+
+static void record_alloc(size_t size, void *ptr) {
+    telemetry.histogram[31 - __builtin_clz(size)]++;
+    if (!ptr) {
+        telemetry.failed_count++;
+        return;
+    }
+    telemetry.alloc_count++;
+    telemetry.current_bytes += payload_block(ptr)->size;
+    if (telemetry.current_bytes > telemetry.peak_bytes) {
+        telemetry.peak_bytes = telemetry.current_bytes;
+    }
+}
+
+static void *finish_alloc(size_t size, void *ptr, const char *tag, void *caller) {
+    record_alloc(size, ptr);
+
+#ifdef KMALLOC_TRACE
+    // Used blocks have no free-list links, so the owner rides in their place.
+    if (ptr) {
+        mem_block_t *block = payload_block(ptr);
+        block->caller = caller;
+        block->tag = tag ? tag : "?";
+    }
+#else
+    (void)tag;
+    (void)caller;
+#endif
+    return ptr;
+}
+
+static void *kmalloc_common(size_t size, const char *tag, void *caller) {
+    if (!memory_initialized || size == 0) return NULL;
+
+    void *ptr = NULL;
+    if (size <= MEM_MAX_CLASS_SIZE) {
+        ptr = class_alloc(size_to_class(size));
+    } else {
+        size_t block_size = request_block_size(size);
+        if (block_size) ptr = heap_alloc(block_size);
+    }
+    return finish_alloc(size, ptr, tag, caller);
+}
+
+void *(kmalloc)(size_t size) {
+    return kmalloc_common(size, NULL, __builtin_return_address(0));
+}
+
+void *kmalloc_tagged(size_t size, const char *tag) {
+    return kmalloc_common(size, tag, __builtin_return_address(0));
+}
+
+void *kmalloc_aligned(size_t size, size_t align) {
+    void *caller = __builtin_return_address(0);
+    if (align <= MEM_ALIGN) return kmalloc_common(size, NULL, caller);
+    if (!memory_initialized || size == 0 || (align & (align - 1))) return NULL;
+
+    size_t need = request_block_size(size);
+    if (!need || need > 0xFFFFFFFF - align - MIN_BLOCK_SIZE) return NULL;
+
+    mem_block_t *block = aligned_block(need, align);
+    return finish_alloc(size, block ? block_payload(block) : NULL, NULL, caller);
+}
+
+// Resizes in place when possible: class blocks keep their slack, general
+// blocks shrink by splitting or grow into a free block right after them.
+// Otherwise the data moves to a fresh block.
+void *krealloc(void *ptr, size_t size) {
+    void *caller = __builtin_return_address(0);
+    if (!ptr) return kmalloc_common(size, NULL, caller);
+    if (size == 0) {
+        kfree(ptr);
+        return NULL;
+    }
+
+    mem_block_t *block = payload_block(ptr);
+    if (!block->used || block->cached) return NULL;
+
+    const char *tag = NULL;
+#ifdef KMALLOC_TRACE
+    tag = block->tag;
+#endif
+
+    size_t capacity;
+    if (block->size_class != MEM_CLASS_NONE) {
+        capacity = class_stats[block->size_class].size;
+        if (size <= capacity) return ptr;
+    } else {
+        size_t need = request_block_size(size);
+        if (!need) return NULL;
+
+        size_t old_size = block->size;
+        mem_block_t *next = block_next(block);
+        if (need > block->size && !next->used && block->size + next->size >= need) {
+            free_list_remove(next);
+            set_block(block, block->size + next->size, true);
+        }
+        if (need <= block->size) {
+            trim_block(block, need);
+            telemetry.current_bytes += block->size - old_size;
+            if (telemetry.current_bytes > telemetry.peak_bytes) {
+                telemetry.peak_bytes = telemetry.current_bytes;
+            }
+            return ptr;
+        }
+        capacity = block->size - BLOCK_OVERHEAD;
+    }
+
+    void *new_ptr = kmalloc_common(size, tag, caller);
+    if (!new_ptr) return NULL;
+    memcpy(new_ptr, ptr, capacity < size ? capacity : size);
+    kfree(ptr);
+    return new_ptr;
 }
 
 void kfree(void *ptr) {
     if (!ptr || !memory_initialized) return;
-    mem_block_t *block = (mem_block_t*)((uint8_t*)ptr - sizeof(mem_block_t));
-    block->used = false;
+    mem_block_t *block = payload_block(ptr);
+    if (!block->used || block->cached) return;
+
+    telemetry.free_count++;
+    telemetry.current_bytes -= block->size;
+
+    if (block->size_class < MEM_NUM_CLASSES) {
+        class_free(block);
+        return;
+    }
+    general_free(block);
 }
 
 void memory_stats(uint32_t *total, uint32_t *used, uint32_t *free) {
-    *total = HEAP_SIZE;
-    *used = 0;
-    *free = 0;
-    mem_block_t *current = first_block;
-    while (current) {
-        if (current->used) {
-            *used += current->size + sizeof(mem_block_t);
-        } else {
-            *free += current->size + sizeof(mem_block_t);
+    *total = heap_total;
+    *used = telemetry.current_bytes;
+    *free = heap_total - heap_overhead - telemetry.current_bytes;
+}
+
+void memory_class_stats(int cls, mem_class_stats_t *stats) {
+    if (cls < 0 || cls >= MEM_NUM_CLASSES) return;
+    *stats = class_stats[cls];
+}
+
+void memory_telemetry(mem_telemetry_t *out) {
+    *out = telemetry;
+    out->heap_total = heap_total;
+}
+
+#ifdef KMALLOC_TRACE
+static void leak_count(mem_site_t *sites, int *count, int max_sites, mem_block_t *block) {
+    int i = 0;
+    while (i < *count && sites[i].caller != block->caller) i++;
+    if (i == *count) {
+        if (*count == max_sites) return;
+        sites[i].caller = block->caller;
+        sites[i].tag = block->tag;
+        sites[i].count = 0;
+        sites[i].bytes = 0;
+        (*count)++;
+    }
+    sites[i].count++;
+    sites[i].bytes += block->size;
+}
+#endif
+
+// Groups live blocks by call site. Walks the whole heap, so it is meant
+// for the memleaks command, not for hot paths. Returns -1 when the kernel
+// was built without KMALLOC_TRACE.
+int memory_leak_report(mem_site_t *sites, int max_sites) {
+#ifdef KMALLOC_TRACE
+    int count = 0;
+    for (mem_region_t *region = regions; region; region = region->next) {
+        mem_block_t *block = (mem_block_t*)(region + 1);
+        for (; block->size; block = block_next(block)) {
+            if (!block->used || block->cached) continue;
+            if (block->size_class != MEM_CLASS_CHUNK) {
+                leak_count(sites, &count, max_sites, block);
+                continue;
+            }
+
+            // The chunk itself is bookkeeping; its objects are the allocations
+            uint8_t *objects = (uint8_t*)block_payload(block) + CHUNK_OBJECTS_OFFSET;
+            int cls = ((mem_block_t*)objects)->size_class;
+            for (uint32_t i = 0; i < chunk_objects(cls); i++) {
+                mem_block_t *object = (mem_block_t*)(objects + i * class_stride(cls));
+                if (!object->cached) leak_count(sites, &count, max_sites, object);
+            }
         }
-        current = current->next;
     }
+    return count;
+#else
+    (void)sites;
+    (void)max_sites;
+    return -1;
+#endif
 }
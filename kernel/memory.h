@@ -3,15 +3,88 @@
 
 #include "../include/types.h"
 
+// Small requests are carved from per-size-class chunks kept apart from
+// the general heap. Classes are powers of two from 16 bytes up to
+// MEM_MAX_CLASS_SIZE.
+#define MEM_MIN_CLASS_SHIFT 4
+#define MEM_NUM_CLASSES 8
+#define MEM_MAX_CLASS_SIZE (1 << (MEM_MIN_CLASS_SHIFT + MEM_NUM_CLASSES - 1))
+#define MEM_CLASS_NONE 0xFF
+
+// Block sizes are multiples of MEM_ALIGN and include header and footer.
+// Payloads start right after the header and are MEM_ALIGN aligned.
+#define MEM_ALIGN 16
+
 typedef struct mem_block {
-    size_t size;
-    bool used;
-    struct mem_block *next;
+    size_t size;                  // Whole block: header + payload + footer
+    bool used;                    // Not available for coalescing
+    bool cached;                  // Free object inside a size-class chunk
+    uint8_t size_class;
+    uint8_t reserved;
+    union {
+        struct {
+            struct mem_block *prev_free;  // Free list links (class: next only)
+            struct mem_block *next_free;
+        };
+        struct {
+            void *caller;                 // Owner while in use (KMALLOC_TRACE)
+            const char *tag;
+        };
+    };
 } mem_block_t;
 
+// Boundary tag at the end of every block, pointing back to its header
+// so kfree can find and merge the lower neighbour in O(1).
+typedef struct {
+    mem_block_t *header;
+} mem_footer_t;
+
+typedef struct {
+    uint32_t size;      // Block size served by this class
+    uint32_t allocs;    // Total kmalloc calls routed to this class
+    uint32_t hits;      // Served from a chunk the class already had
+    uint32_t cached;    // Free objects in the class's chunks
+} mem_class_stats_t;
+
+#define MEM_HIST_BUCKETS 32
+
+// Maintained incrementally on every kmalloc/kfree, so reading it is O(1).
+typedef struct {
+    uint32_t heap_total;        // Heap address space handed to the allocator
+    uint32_t current_bytes;     // Bytes in live blocks, headers included
+    uint32_t peak_bytes;
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t failed_count;
+    uint32_t histogram[MEM_HIST_BUCKETS];  // Requests by floor(log2(size))
+} mem_telemetry_t;
+
+// Outstanding allocations from one call site, for the leak report.
+typedef struct {
+    void *caller;
+    const char *tag;
+    uint32_t count;
+    uint32_t bytes;
+} mem_site_t;
+
 void memory_init(void);
 void *kmalloc(size_t size);
+void *kmalloc_tagged(size_t size, const char *tag);
+void *kmalloc_aligned(size_t size, size_t align);
+void *krealloc(void *ptr, size_t size);
 void kfree(void *ptr);
 void memory_stats(uint32_t *total, uint32_t *used, uint32_t *free);
+void memory_class_stats(int cls, mem_class_stats_t *stats);
+void memory_telemetry(mem_telemetry_t *telemetry);
+int memory_leak_report(mem_site_t *sites, int max_sites);
+
+// Tracing builds tag every plain kmalloc with the file it was called from.
+// A file can pick a shorter tag by defining KMALLOC_TAG before this header.
+#ifdef KMALLOC_TRACE
+#ifndef KMALLOC_TAG
+#define KMALLOC_TAG __FILE__
+#endif
+#define kmalloc(size) kmalloc_tagged((size), KMALLOC_TAG)
+#endif
 
 #endif
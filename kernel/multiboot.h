@@ -0,0 +1,32 @@
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include "../include/types.h"
+
+#define MULTIBOOT_FLAG_MEM  0x001   // mem_lower / mem_upper valid
+#define MULTIBOOT_FLAG_MMAP 0x040   // mmap_addr / mmap_length valid
+
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+} __attribute__((packed)) multiboot_info_t;
+
+// Entries are variable length: the next one starts size + 4 bytes on.
+typedef struct {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+#endif
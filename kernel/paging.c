@@ -0,0 +1,131 @@
+/* ================================================
+ * kernel/paging.c - Paging and demand-mapped heap
+ * ================================================ */
+#include "paging.h"
+#include "pmm.h"
+#include "irq.h"
+#include "kernel.h"
+#include "../lib/stdio/stdio.h"
+
+#define LARGE_PAGE_SIZE 0x400000
+#define RECURSIVE_SLOT 1023
+
+// With the last directory slot pointing at the directory itself, every
+// page table shows up in the top 4 MB of the address space.
+#define PAGE_TABLES ((uint32_t*)0xFFC00000)
+
+#define CR0_PG  0x80000000
+#define CR4_PSE 0x00000010
+
+static uint32_t page_directory[1024] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t heap_brk = KERNEL_HEAP_START;
+static uint32_t heap_pages = 0;
+
+// Freed pages stay mapped and are chained through their first word, so
+// the next page_alloc reuses them without touching the page tables.
+static uint32_t pages_brk = KERNEL_PAGES_START;
+static void *free_pages = NULL;
+
+static void invlpg(uint32_t addr) {
+    __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+static bool map_page(uint32_t virt, uint32_t phys, uint32_t flags) {
+    uint32_t pdi = virt >> 22;
+    if (!(page_directory[pdi] & PAGE_PRESENT)) {
+        uint32_t table = pmm_alloc_frame();
+        if (!table) return false;
+        page_directory[pdi] = table | PAGE_PRESENT | PAGE_WRITE;
+
+        uint32_t *entries = &PAGE_TABLES[pdi * 1024];
+        invlpg((uint32_t)entries);
+        for (int i = 0; i < 1024; i++) {
+            entries[i] = 0;
+        }
+    }
+    PAGE_TABLES[virt >> 12] = phys | flags;
+    invlpg(virt);
+    return true;
+}
+
+static void page_fault_handler(registers_t *regs) {
+    uint32_t addr;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(addr));
+
+    // Not-present fault inside the reserved heap window: commit a frame.
+    if (!(regs->err_code & PAGE_PRESENT) &&
+        addr >= KERNEL_HEAP_START && addr < heap_brk) {
+        uint32_t frame = pmm_alloc_frame();
+        if (frame && map_page(addr & ~(PAGE_SIZE - 1), frame, PAGE_PRESENT | PAGE_WRITE)) {
+            heap_pages++;
+            return;
+        }
+        kernel_panic("Out of memory while growing the heap");
+    }
+
+    static char message[64];
+    snprintf(message, sizeof(message), "Page fault at 0x%x (error %d)", addr, regs->err_code);
+    kernel_panic(message);
+}
+
+void paging_init(void) {
+    for (int i = 0; i < 1024; i++) {
+        page_directory[i] = 0;
+    }
+
+    // Identity map the image, low memory and the frame bitmap with 4 MB pages.
+    uint32_t identity_end = pmm_reserved_end();
+    for (uint32_t addr = 0; addr < identity_end; addr += LARGE_PAGE_SIZE) {
+        page_directory[addr >> 22] = addr | PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE;
+    }
+    page_directory[RECURSIVE_SLOT] = (uint32_t)page_directory | PAGE_PRESENT | PAGE_WRITE;
+
+    isr_install_handler(14, page_fault_handler);
+
+    uint32_t cr0, cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_PSE));
+    __asm__ volatile("mov %0, %%cr3" : : "r"(page_directory) : "memory");
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0 | CR0_PG) : "memory");
+}
+
+// Reserves more of the heap window. Nothing is mapped until touched.
+void *paging_heap_grow(size_t bytes) {
+    bytes = (bytes + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (bytes > KERNEL_HEAP_START + KERNEL_HEAP_MAX - heap_brk) return NULL;
+    void *start = (void*)heap_brk;
+    heap_brk += bytes;
+    return start;
+}
+
+void paging_heap_stats(uint32_t *reserved, uint32_t *committed) {
+    *reserved = heap_brk - KERNEL_HEAP_START;
+    *committed = heap_pages * PAGE_SIZE;
+}
+
+void *page_alloc(void) {
+    if (free_pages) {
+        void *page = free_pages;
+        free_pages = *(void**)page;
+        return page;
+    }
+
+    if (pages_brk >= KERNEL_PAGES_START + KERNEL_PAGES_MAX) return NULL;
+    uint32_t frame = pmm_alloc_frame();
+    if (!frame) return NULL;
+    if (!map_page(pages_brk, frame, PAGE_PRESENT | PAGE_WRITE)) {
+        pmm_free_frames(frame, 1);
+        return NULL;
+    }
+
+    void *page = (void*)pages_brk;
+    pages_brk += PAGE_SIZE;
+    return page;
+}
+
+void page_free(void *page) {
+    if (!page) return;
+    *(void**)page = free_pages;
+    free_pages = page;
+}
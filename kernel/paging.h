@@ -0,0 +1,25 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "../include/types.h"
+
+#define PAGE_PRESENT 0x001
+#define PAGE_WRITE   0x002
+#define PAGE_LARGE   0x080   // 4 MB page, needs CR4.PSE
+
+// The kernel heap lives in its own virtual window. Frames are only
+// mapped in when the page fault handler sees the first touch.
+#define KERNEL_HEAP_START 0xD0000000
+#define KERNEL_HEAP_MAX   0x10000000
+
+// Whole pages handed out by page_alloc, mapped eagerly.
+#define KERNEL_PAGES_START 0xE0000000
+#define KERNEL_PAGES_MAX   0x10000000
+
+void paging_init(void);
+void *paging_heap_grow(size_t bytes);
+void paging_heap_stats(uint32_t *reserved, uint32_t *committed);
+void *page_alloc(void);
+void page_free(void *page);
+
+#endif
@@ -0,0 +1,198 @@
+/* ================================================
+ * kernel/pmm.c - Physical page-frame allocator
+ * ================================================ */
+#include "pmm.h"
+#include "klog.h"
+#include "kernel.h"
+
+#define FRAME_NONE 0xFFFFFFFF
+#define LOW_MEMORY_END 0x100000
+#define RUN_SCAN_LIMIT 1024
+
+extern uint8_t _kernel_start[];
+extern uint8_t _kernel_end[];
+
+// One bit per frame, set = used. Lives right after the kernel image.
+static uint32_t *frame_bitmap = NULL;
+static uint32_t frame_count = 0;
+static uint32_t usable_frames = 0;
+static uint32_t free_count = 0;
+static uint32_t search_hint = 0;    // Every bitmap word below this is full
+static uint32_t reserved_end = 0;
+
+// Tail of the free run found by the last search, so a stream of small
+// allocations peels frames off in O(1) instead of rescanning the bitmap.
+static uint32_t run_start = 0;
+static uint32_t run_len = 0;
+
+static void set_frames(uint32_t first, uint32_t count, bool used) {
+    for (uint32_t f = first; f < first + count && f < frame_count; f++) {
+        uint32_t *word = &frame_bitmap[f / 32];
+        uint32_t mask = 1u << (f % 32);
+        if (used && !(*word & mask)) {
+            *word |= mask;
+            free_count--;
+        } else if (!used && (*word & mask)) {
+            *word &= ~mask;
+            free_count++;
+        }
+    }
+}
+
+static uint64_t region_limit(uint64_t addr, uint64_t len) {
+    uint64_t end = addr + len;
+    return end > 0x100000000ULL ? 0x100000000ULL : end;
+}
+
+static void add_usable(uint64_t addr, uint64_t len) {
+    uint64_t end = region_limit(addr, len);
+    uint64_t first = (addr + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t last = end / PAGE_SIZE;
+    if (last <= first) return;
+    set_frames((uint32_t)first, (uint32_t)(last - first), false);
+    usable_frames += (uint32_t)(last - first);
+}
+
+void pmm_init(multiboot_info_t *mbi) {
+    uint64_t top = 0;
+    multiboot_mmap_entry_t *entry;
+    uint32_t mmap_end = 0;
+
+    if (mbi->flags & MULTIBOOT_FLAG_MMAP) {
+        mmap_end = mbi->mmap_addr + mbi->mmap_length;
+        for (entry = (multiboot_mmap_entry_t*)mbi->mmap_addr;
+             (uint32_t)entry < mmap_end;
+             entry = (multiboot_mmap_entry_t*)((uint8_t*)entry + entry->size + 4)) {
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE) {
+                uint64_t end = region_limit(entry->addr, entry->len);
+                if (end > top) top = end;
+            }
+        }
+    } else if (mbi->flags & MULTIBOOT_FLAG_MEM) {
+        top = LOW_MEMORY_END + (uint64_t)mbi->mem_upper * 1024;
+    }
+
+    frame_count = (uint32_t)(top / PAGE_SIZE);
+    if (frame_count == 0) return;
+
+    uint32_t words = (frame_count + 31) / 32;
+    frame_bitmap = (uint32_t*)(((uint32_t)_kernel_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+    for (uint32_t i = 0; i < words; i++) {
+        frame_bitmap[i] = 0xFFFFFFFF;
+    }
+    free_count = 0;
+    usable_frames = 0;
+
+    if (mbi->flags & MULTIBOOT_FLAG_MMAP) {
+        for (entry = (multiboot_mmap_entry_t*)mbi->mmap_addr;
+             (uint32_t)entry < mmap_end;
+             entry = (multiboot_mmap_entry_t*)((uint8_t*)entry + entry->size + 4)) {
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE) {
+                add_usable(entry->addr, entry->len);
+            }
+        }
+    } else {
+        add_usable(LOW_MEMORY_END, (uint64_t)mbi->mem_upper * 1024);
+    }
+
+    // BIOS area, kernel image and the bitmap itself are never handed out.
+    reserved_end = (uint32_t)frame_bitmap + words * 4;
+    set_frames(0, LOW_MEMORY_END / PAGE_SIZE, true);
+    set_frames((uint32_t)_kernel_start / PAGE_SIZE,
+               (reserved_end + PAGE_SIZE - 1) / PAGE_SIZE - (uint32_t)_kernel_start / PAGE_SIZE,
+               true);
+
+    search_hint = 0;
+    run_len = 0;
+    klog(KLOG_INFO, "pmm: %u KB usable, %u frames free", usable_frames * (PAGE_SIZE / 1024), free_count);
+}
+
+// Finds a run of at least count free frames starting at or after the
+// search hint. *len receives the run length, measured up to a limit.
+static uint32_t find_free_run(uint32_t count, uint32_t *len) {
+    uint32_t words = (frame_count + 31) / 32;
+    uint32_t start = 0;
+    uint32_t run = 0;
+    bool hint_set = false;
+    uint32_t limit = count > RUN_SCAN_LIMIT ? count : RUN_SCAN_LIMIT;
+
+    bool done = false;
+
+    for (uint32_t w = search_hint; w < words && !done; w++) {
+        uint32_t bits = frame_bitmap[w];
+        if (bits == 0xFFFFFFFF) {
+            if (run >= count) break;
+            run = 0;
+            continue;
+        }
+        if (!hint_set) {
+            search_hint = w;
+            hint_set = true;
+        }
+        if (bits == 0 && (w + 1) * 32 <= frame_count) {
+            if (run == 0) start = w * 32;
+            run += 32;
+        } else {
+            for (uint32_t b = 0; b < 32 && w * 32 + b < frame_count; b++) {
+                if (bits & (1u << b)) {
+                    if (run >= count) {
+                        done = true;
+                        break;
+                    }
+                    run = 0;
+                } else {
+                    if (run == 0) start = w * 32 + b;
+                    run++;
+                }
+            }
+        }
+        if (run >= limit) break;
+    }
+
+    if (!hint_set) search_hint = words;
+    if (run < count) return FRAME_NONE;
+    *len = run;
+    return start;
+}
+
+uint32_t pmm_alloc_frames(uint32_t count) {
+    if (!frame_bitmap || count == 0 || count > free_count) return 0;
+
+    uint32_t first;
+    if (run_len >= count) {
+        first = run_start;
+    } else {
+        uint32_t len;
+        first = find_free_run(count, &len);
+        if (first == FRAME_NONE) return 0;
+        run_len = len;
+    }
+    run_start = first + count;
+    run_len -= count;
+
+    set_frames(first, count, true);
+    return first * PAGE_SIZE;
+}
+
+uint32_t pmm_alloc_frame(void) {
+    return pmm_alloc_frames(1);
+}
+
+void pmm_free_frames(uint32_t addr, uint32_t count) {
+    if (!frame_bitmap) return;
+    uint32_t first = addr / PAGE_SIZE;
+    set_frames(first, count, false);
+    if (first / 32 < search_hint) {
+        search_hint = first / 32;
+    }
+}
+
+// End of the memory the kernel touches through its identity mapping.
+uint32_t pmm_reserved_end(void) {
+    return reserved_end ? reserved_end : (uint32_t)_kernel_end;
+}
+
+void pmm_stats(uint32_t *total_frames, uint32_t *free_frames) {
+    *total_frames = usable_frames;
+    *free_frames = free_count;
+}
@@ -0,0 +1,16 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include "../include/types.h"
+#include "multiboot.h"
+
+#define PAGE_SIZE 4096
+
+void pmm_init(multiboot_info_t *mbi);
+uint32_t pmm_alloc_frame(void);
+uint32_t pmm_alloc_frames(uint32_t count);
+void pmm_free_frames(uint32_t addr, uint32_t count);
+void pmm_stats(uint32_t *total_frames, uint32_t *free_frames);
+uint32_t pmm_reserved_end(void);
+
+#endif
@@ -0,0 +1,156 @@
+/* ================================================
+ * kernel/slab.c - Object caches for fixed-size structures
+ * ================================================ */
+#include "slab.h"
+#include "paging.h"
+#include "pmm.h"
+#include "kernel.h"
+
+// Each slab is one page: this header, then objects starting on the next
+// cache line. The slab of any object is found by masking its address.
+typedef struct slab {
+    struct slab *prev;
+    struct slab *next;
+    kmem_cache_t *cache;
+    void *free;             // Free objects chained through their first word
+    uint32_t in_use;
+} slab_t;
+
+struct kmem_cache {
+    char name[KMEM_CACHE_NAME_LEN];
+    uint32_t object_size;
+    uint32_t stride;
+    uint32_t per_slab;
+    slab_t *partial;
+    slab_t *full;
+    slab_t *empty;          // At most one spare slab is kept around
+    uint32_t slab_count;
+    uint32_t active;
+};
+
+#define SLAB_OBJECTS_OFFSET ((sizeof(slab_t) + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1))
+
+static kmem_cache_t caches[KMEM_MAX_CACHES];
+static int cache_count = 0;
+
+static void slab_list_add(slab_t **list, slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) (*list)->prev = slab;
+    *list = slab;
+}
+
+static void slab_list_remove(slab_t **list, slab_t *slab) {
+    if (slab->prev) slab->prev->next = slab->next;
+    else *list = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+}
+
+kmem_cache_t *kmem_cache_create(const char *name, size_t size) {
+    if (cache_count >= KMEM_MAX_CACHES || size == 0) return NULL;
+
+    uint32_t stride = (size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+    if (stride > PAGE_SIZE - SLAB_OBJECTS_OFFSET) return NULL;
+
+    kmem_cache_t *cache = &caches[cache_count++];
+    int i = 0;
+    for (; name[i] && i < KMEM_CACHE_NAME_LEN - 1; i++) {
+        cache->name[i] = name[i];
+    }
+    cache->name[i] = '\0';
+    cache->object_size = size;
+    cache->stride = stride;
+    cache->per_slab = (PAGE_SIZE - SLAB_OBJECTS_OFFSET) / stride;
+    cache->partial = NULL;
+    cache->full = NULL;
+    cache->empty = NULL;
+    cache->slab_count = 0;
+    cache->active = 0;
+    return cache;
+}
+
+static slab_t *slab_create(kmem_cache_t *cache) {
+    slab_t *slab = (slab_t*)page_alloc();
+    if (!slab) return NULL;
+
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->free = NULL;
+
+    // Chain objects so the lowest address is handed out first.
+    uint8_t *objects = (uint8_t*)slab + SLAB_OBJECTS_OFFSET;
+    for (int i = cache->per_slab - 1; i >= 0; i--) {
+        void *obj = objects + i * cache->stride;
+        *(void**)obj = slab->free;
+        slab->free = obj;
+    }
+    cache->slab_count++;
+    return slab;
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    if (!cache) return NULL;
+
+    slab_t *slab = cache->partial;
+    if (!slab) {
+        slab = cache->empty;
+        if (slab) {
+            cache->empty = NULL;
+        } else {
+            slab = slab_create(cache);
+            if (!slab) return NULL;
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    void *obj = slab->free;
+    slab->free = *(void**)obj;
+    slab->in_use++;
+    cache->active++;
+
+    if (slab->in_use == cache->per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    if (!cache || !obj) return;
+    slab_t *slab = (slab_t*)((uint32_t)obj & ~(PAGE_SIZE - 1));
+    if (slab->cache != cache) {
+        kernel_panic("kmem_cache_free: object from another cache");
+    }
+
+    if (slab->in_use == cache->per_slab) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    *(void**)obj = slab->free;
+    slab->free = obj;
+    slab->in_use--;
+    cache->active--;
+
+    if (slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if (cache->empty) {
+            page_free(slab);
+            cache->slab_count--;
+        } else {
+            cache->empty = slab;
+        }
+    }
+}
+
+int kmem_cache_stats(int index, kmem_cache_stats_t *stats) {
+    if (index < 0 || index >= cache_count) return -1;
+    kmem_cache_t *cache = &caches[index];
+    stats->name = cache->name;
+    stats->object_size = cache->object_size;
+    stats->stride = cache->stride;
+    stats->slabs = cache->slab_count;
+    stats->active = cache->active;
+    stats->total = cache->slab_count * cache->per_slab;
+    return 0;
+}
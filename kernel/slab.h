@@ -0,0 +1,26 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "../include/types.h"
+
+#define CACHE_LINE_SIZE 64
+#define KMEM_MAX_CACHES 16
+#define KMEM_CACHE_NAME_LEN 16
+
+typedef struct kmem_cache kmem_cache_t;
+
+typedef struct {
+    const char *name;
+    uint32_t object_size;   // Size requested at creation
+    uint32_t stride;        // Cache-line aligned size actually used
+    uint32_t slabs;         // Pages owned by the cache
+    uint32_t active;        // Objects currently allocated
+    uint32_t total;         // Object capacity of all slabs
+} kmem_cache_stats_t;
+
+kmem_cache_t *kmem_cache_create(const char *name, size_t size);
+void *kmem_cache_alloc(kmem_cache_t *cache);
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
+int kmem_cache_stats(int index, kmem_cache_stats_t *stats);
+
+#endif
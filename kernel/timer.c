@@ -4,6 +4,8 @@
 #include "timer.h"
 #include "irq.h"
 #include "kernel.h"
+#include "klog.h"
+#include "../drivers/vga/vga.h"
 
 static volatile uint32_t timer_ticks = 0;
 static uint32_t timer_frequency = 0;
@@ -11,6 +13,8 @@ static uint32_t timer_frequency = 0;
 static void timer_handler(registers_t *regs) {
     (void)regs;
     timer_ticks++;
+    klog_pump();
+    vga_flush();
 }
 
 void timer_init(uint32_t frequency) {
@@ -30,6 +34,10 @@ uint32_t timer_get_seconds(void) {
     return timer_ticks / timer_frequency;
 }
 
+uint32_t timer_get_frequency(void) {
+    return timer_frequency;
+}
+
 void timer_sleep(uint32_t ms) {
     uint32_t target = timer_ticks + (ms * timer_frequency / 1000);
     while (timer_ticks < target) {
@@ -6,6 +6,7 @@
 void timer_init(uint32_t frequency);
 uint32_t timer_get_ticks(void);
 uint32_t timer_get_seconds(void);
+uint32_t timer_get_frequency(void);
 void timer_sleep(uint32_t ms);
 
 #endif
@@ -2,71 +2,296 @@
 #include "../string/string.h"
 #include "../../drivers/vga/vga.h"
 
-void putchar(char c) {
-    vga_putchar(c);
+#define CONSOLE_BUF_SIZE 256
+
+#define FLAG_LEFT   (1 << 0)    // '-'
+#define FLAG_ZERO   (1 << 1)    // '0'
+#define FLAG_PLUS   (1 << 2)    // '+'
+#define FLAG_SPACE  (1 << 3)    // ' '
+#define FLAG_ALT    (1 << 4)    // '#'
+#define FLAG_UPPER  (1 << 5)    // %X
+
+typedef struct {
+    uint32_t flags;
+    int width;
+    int precision;              // -1 when not given
+} format_spec_t;
+
+// "00" "01" ... "99": two decimal digits per division step
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static void emit(printf_sink_t sink, void *ctx, const char *data, size_t len, int *total) {
+    if (len) sink(ctx, data, len);
+    *total += len;
+}
+
+static void emit_repeat(printf_sink_t sink, void *ctx, char c, int count, int *total) {
+    static const char spaces[] = "                ";
+    static const char zeros[] = "0000000000000000";
+    const char *fill = c == '0' ? zeros : spaces;
+    while (count > 0) {
+        int chunk = count < 16 ? count : 16;
+        emit(sink, ctx, fill, chunk, total);
+        count -= chunk;
+    }
 }
 
-static void print_int(char *buf, int *pos, int value, int base) {
-    char temp[32];
-    int i = 0;
-    bool negative = false;
-    
-    if (value < 0 && base == 10) {
-        negative = true;
-        value = -value;
+// Divides *n in place and returns the remainder using two 32-bit divl
+// steps, so 64-bit values need no libgcc helper.
+static uint32_t div64_32(uint64_t *n, uint32_t base) {
+    uint32_t high = (uint32_t)(*n >> 32);
+    uint32_t low = (uint32_t)*n;
+    uint32_t rem = 0;
+    if (high >= base) {
+        rem = high % base;
+        high /= base;
+    } else {
+        rem = high;
+        high = 0;
     }
-    
-    if (value == 0) {
-        temp[i++] = '0';
+    __asm__("divl %2" : "=a"(low), "=d"(rem) : "rm"(base), "0"(low), "1"(rem));
+    *n = ((uint64_t)high << 32) | low;
+    return rem;
+}
+
+// Writes value right-aligned ending at end; returns the first digit.
+static char *format_decimal32(char *end, uint32_t value) {
+    while (value >= 100) {
+        const char *pair = &digit_pairs[(value % 100) * 2];
+        value /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    if (value >= 10) {
+        *--end = digit_pairs[value * 2 + 1];
+        *--end = digit_pairs[value * 2];
     } else {
-        while (value > 0) {
-            int digit = value % base;
-            temp[i++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
-            value /= base;
+        *--end = '0' + value;
+    }
+    return end;
+}
+
+static char *format_decimal(char *end, uint64_t value) {
+    // Peel off 8 digits at a time until the rest fits in 32 bits
+    while (value >> 32) {
+        uint32_t chunk = div64_32(&value, 100000000);
+        char *start = format_decimal32(end, chunk);
+        while (start > end - 8) *--start = '0';
+        end = start;
+    }
+    return format_decimal32(end, (uint32_t)value);
+}
+
+static char *format_power2(char *end, uint64_t value, int shift, bool upper) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    uint32_t mask = (1u << shift) - 1;
+    do {
+        *--end = digits[(uint32_t)value & mask];
+        value >>= shift;
+    } while (value);
+    return end;
+}
+
+static void format_int(printf_sink_t sink, void *ctx, int *total, const format_spec_t *spec,
+                       uint64_t value, bool negative, char conv) {
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *digits = end;
+
+    // Precision 0 with a zero value prints no digits at all
+    if (value || spec->precision != 0) {
+        if (conv == 'x' || conv == 'X' || conv == 'p') {
+            digits = format_power2(end, value, 4, spec->flags & FLAG_UPPER);
+        } else if (conv == 'o') {
+            digits = format_power2(end, value, 3, false);
+        } else {
+            digits = format_decimal(end, value);
         }
     }
-    
-    if (negative) temp[i++] = '-';
-    
-    while (i > 0) {
-        buf[(*pos)++] = temp[--i];
+    int ndigits = end - digits;
+
+    const char *prefix = "";
+    if (negative) prefix = "-";
+    else if (spec->flags & FLAG_PLUS) prefix = "+";
+    else if (spec->flags & FLAG_SPACE) prefix = " ";
+    if ((spec->flags & FLAG_ALT) && (value || conv == 'p')) {
+        if (conv == 'x' || conv == 'p') prefix = "0x";
+        else if (conv == 'X') prefix = "0X";
+    }
+    // '#' makes octal start with a 0, even when precision 0 dropped the digit
+    if ((spec->flags & FLAG_ALT) && conv == 'o' && spec->precision <= ndigits &&
+        (ndigits == 0 || digits[0] != '0')) {
+        prefix = "0";
     }
+    int prefix_len = strlen(prefix);
+
+    int zeros = spec->precision > ndigits ? spec->precision - ndigits : 0;
+    int pad = spec->width - prefix_len - zeros - ndigits;
+    if ((spec->flags & (FLAG_ZERO | FLAG_LEFT)) == FLAG_ZERO && spec->precision < 0 && pad > 0) {
+        zeros += pad;
+        pad = 0;
+    }
+
+    if (!(spec->flags & FLAG_LEFT)) emit_repeat(sink, ctx, ' ', pad, total);
+    emit(sink, ctx, prefix, prefix_len, total);
+    emit_repeat(sink, ctx, '0', zeros, total);
+    emit(sink, ctx, digits, ndigits, total);
+    if (spec->flags & FLAG_LEFT) emit_repeat(sink, ctx, ' ', pad, total);
 }
 
-int vsprintf(char *str, const char *format, va_list args) {
-    int pos = 0;
-    
+static void format_text(printf_sink_t sink, void *ctx, int *total, const format_spec_t *spec,
+                        const char *text, int len) {
+    int pad = spec->width - len;
+    if (!(spec->flags & FLAG_LEFT)) emit_repeat(sink, ctx, ' ', pad, total);
+    emit(sink, ctx, text, len, total);
+    if (spec->flags & FLAG_LEFT) emit_repeat(sink, ctx, ' ', pad, total);
+}
+
+static int parse_number(const char **format) {
+    int value = 0;
+    while (**format >= '0' && **format <= '9') {
+        value = value * 10 + (*(*format)++ - '0');
+    }
+    return value;
+}
+
+int vsinkprintf(printf_sink_t sink, void *ctx, const char *format, va_list args) {
+    int total = 0;
+
     while (*format) {
-        if (*format == '%') {
-            format++;
-            switch (*format) {
-                case 'd':
-                case 'i':
-                    print_int(str, &pos, va_arg(args, int), 10);
-                    break;
-                case 'x':
-                    print_int(str, &pos, va_arg(args, unsigned int), 16);
-                    break;
-                case 'c':
-                    str[pos++] = (char)va_arg(args, int);
-                    break;
-                case 's': {
-                    char *s = va_arg(args, char*);
-                    while (*s) str[pos++] = *s++;
-                    break;
-                }
-                case '%':
-                    str[pos++] = '%';
-                    break;
+        // Literal runs go straight from the format string to the sink
+        const char *run = format;
+        while (*format && *format != '%') format++;
+        emit(sink, ctx, run, format - run, &total);
+        if (!*format) break;
+        format++;
+
+        format_spec_t spec = { 0, 0, -1 };
+        for (;; format++) {
+            if (*format == '-') spec.flags |= FLAG_LEFT;
+            else if (*format == '0') spec.flags |= FLAG_ZERO;
+            else if (*format == '+') spec.flags |= FLAG_PLUS;
+            else if (*format == ' ') spec.flags |= FLAG_SPACE;
+            else if (*format == '#') spec.flags |= FLAG_ALT;
+            else break;
+        }
+
+        if (*format == '*') {
+            spec.width = va_arg(args, int);
+            if (spec.width < 0) {
+                spec.flags |= FLAG_LEFT;
+                spec.width = -spec.width;
             }
+            format++;
         } else {
-            str[pos++] = *format;
+            spec.width = parse_number(&format);
+        }
+
+        if (*format == '.') {
+            format++;
+            if (*format == '*') {
+                spec.precision = va_arg(args, int);
+                if (spec.precision < 0) spec.precision = -1;
+                format++;
+            } else {
+                spec.precision = parse_number(&format);
+            }
+        }
+
+        // Length modifiers; only ll changes the argument size on i386,
+        // h and hh narrow the promoted int back down
+        int longs = 0, shorts = 0;
+        while (*format == 'l' || *format == 'h' || *format == 'z') {
+            if (*format == 'l') longs++;
+            if (*format == 'h') shorts++;
+            format++;
+        }
+
+        char conv = *format;
+        switch (conv) {
+            case 'd':
+            case 'i': {
+                int64_t value = longs >= 2 ? va_arg(args, int64_t) : va_arg(args, int);
+                if (shorts == 1) value = (short)value;
+                if (shorts >= 2) value = (signed char)value;
+                uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+                format_int(sink, ctx, &total, &spec, magnitude, value < 0, conv);
+                break;
+            }
+            case 'X':
+                spec.flags |= FLAG_UPPER;
+                // fall through
+            case 'u':
+            case 'x':
+            case 'o': {
+                uint64_t value = longs >= 2 ? va_arg(args, uint64_t) : va_arg(args, unsigned int);
+                if (shorts == 1) value = (unsigned short)value;
+                if (shorts >= 2) value = (unsigned char)value;
+                spec.flags &= ~(FLAG_PLUS | FLAG_SPACE);
+                format_int(sink, ctx, &total, &spec, value, false, conv);
+                break;
+            }
+            case 'p': {
+                uint32_t value = (uint32_t)va_arg(args, void*);
+                spec.flags = (spec.flags & FLAG_LEFT) | FLAG_ALT;
+                spec.precision = 8;
+                format_int(sink, ctx, &total, &spec, value, false, conv);
+                break;
+            }
+            case 'c': {
+                char c = (char)va_arg(args, int);
+                format_text(sink, ctx, &total, &spec, &c, 1);
+                break;
+            }
+            case 's': {
+                const char *s = va_arg(args, const char*);
+                if (!s) s = "(null)";
+                // With a precision the string need not be terminated
+                int len = 0;
+                while ((spec.precision < 0 || len < spec.precision) && s[len]) len++;
+                format_text(sink, ctx, &total, &spec, s, len);
+                break;
+            }
+            case '%':
+                emit(sink, ctx, "%", 1, &total);
+                break;
+            case '\0':
+                return total;
         }
         format++;
     }
-    
-    str[pos] = '\0';
-    return pos;
+    return total;
+}
+
+static void string_sink(void *ctx, const char *data, size_t len) {
+    string_buf_t *out = ctx;
+    if (out->pos + 1 < out->size) {
+        size_t room = out->size - 1 - out->pos;
+        memcpy(out->buf + out->pos, data, len < room ? len : room);
+    }
+    out->pos += len;
+}
+
+int vsnprintf(char *str, size_t size, const char *format, va_list args) {
+    string_buf_t out = { str, size, 0 };
+    int ret = vsinkprintf(string_sink, &out, format, args);
+    if (size) str[out.pos < size ? out.pos : size - 1] = '\0';
+    return ret;
+}
+
+int snprintf(char *str, size_t size, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int ret = vsnprintf(str, size, format, args);
+    va_end(args);
+    return ret;
+}
+
+int vsprintf(char *str, const char *format, va_list args) {
+    return vsnprintf(str, (size_t)-1 >> 1, format, args);
 }
 
 int sprintf(char *str, const char *format, ...) {
@@ -77,12 +302,126 @@ int sprintf(char *str, const char *format, ...) {
     return ret;
 }
 
+static void console_write(stream_t *stream, const char *data, size_t len) {
+    (void)stream;
+    vga_write(data, len);
+}
+
+static char console_out_buf[CONSOLE_BUF_SIZE];
+static char console_err_buf[CONSOLE_BUF_SIZE];
+
+stream_t console_out = {
+    console_write, NULL, NULL, console_out_buf, CONSOLE_BUF_SIZE, 0, STREAM_CALL, false
+};
+stream_t console_err = {
+    console_write, NULL, NULL, console_err_buf, CONSOLE_BUF_SIZE, 0, STREAM_CALL, false
+};
+stream_t *stdout = &console_out;
+stream_t *stderr = &console_err;
+
+void stream_init(stream_t *stream, stream_write_t write, void *ctx,
+                 char *buf, size_t size, uint8_t mode) {
+    stream->write = write;
+    stream->sync = NULL;
+    stream->ctx = ctx;
+    stream->buf = buf;
+    stream->size = buf ? size : 0;
+    stream->len = 0;
+    stream->mode = mode;
+    stream->error = false;
+}
+
+static void string_write(stream_t *stream, const char *data, size_t len) {
+    string_buf_t *str = stream->ctx;
+    if (str->pos + len >= str->size) stream->error = true;
+    string_sink(str, data, len);
+    if (str->size) str->buf[str->pos < str->size ? str->pos : str->size - 1] = '\0';
+}
+
+void stream_open_string(stream_t *stream, string_buf_t *str, char *buf, size_t size) {
+    str->buf = buf;
+    str->size = size;
+    str->pos = 0;
+    if (size) buf[0] = '\0';
+    stream_init(stream, string_write, str, NULL, 0, STREAM_FULL);
+}
+
+static void drain(stream_t *stream) {
+    if (stream->len) {
+        stream->write(stream, stream->buf, stream->len);
+        stream->len = 0;
+    }
+}
+
+void stream_write(stream_t *stream, const void *data, size_t len) {
+    if (len == 0) return;
+    if (len > stream->size - stream->len) {
+        drain(stream);
+        // Too big to be worth staging: hand it over as it is
+        if (len >= stream->size) {
+            stream->write(stream, data, len);
+            return;
+        }
+    }
+    memcpy(stream->buf + stream->len, data, len);
+    stream->len += len;
+    if (stream->mode == STREAM_LINE && memchr(data, '\n', len)) drain(stream);
+}
+
+static void end_call(stream_t *stream) {
+    if (stream->mode == STREAM_CALL) drain(stream);
+}
+
+int fflush(stream_t *stream) {
+    drain(stream);
+    if (stream->sync) stream->sync(stream);
+    return stream->error ? -1 : 0;
+}
+
+int fputc(int c, stream_t *stream) {
+    char ch = (char)c;
+    stream_write(stream, &ch, 1);
+    end_call(stream);
+    return (unsigned char)ch;
+}
+
+int fputs(const char *str, stream_t *stream) {
+    size_t len = strlen(str);
+    stream_write(stream, str, len);
+    end_call(stream);
+    return (int)len;
+}
+
+static void stream_sink(void *ctx, const char *data, size_t len) {
+    stream_write(ctx, data, len);
+}
+
+int vfprintf(stream_t *stream, const char *format, va_list args) {
+    int ret = vsinkprintf(stream_sink, stream, format, args);
+    end_call(stream);
+    return ret;
+}
+
+int fprintf(stream_t *stream, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int ret = vfprintf(stream, format, args);
+    va_end(args);
+    return ret;
+}
+
+int vprintf(const char *format, va_list args) {
+    return vfprintf(stdout, format, args);
+}
+
 int printf(const char *format, ...) {
-    char buffer[1024];
     va_list args;
     va_start(args, format);
-    int ret = vsprintf(buffer, format, args);
+    int ret = vprintf(format, args);
     va_end(args);
-    vga_puts(buffer);
     return ret;
 }
+
+void putchar(char c) {
+    fputc(c, stdout);
+}
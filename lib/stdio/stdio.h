@@ -8,8 +8,72 @@ typedef __builtin_va_list va_list;
 #define va_arg(ap, type) __builtin_va_arg(ap, type)
 #define va_end(ap) __builtin_va_end(ap)
 
-int printf(const char *format, ...);
+// Formatted output is produced in pieces and handed to a sink as it
+// goes: literal runs straight from the format string, each conversion
+// in one call. Nothing is staged, so output length is unbounded.
+typedef void (*printf_sink_t)(void *ctx, const char *data, size_t len);
+
+int vsinkprintf(printf_sink_t sink, void *ctx, const char *format, va_list args);
+
+// Never writes more than size bytes including the terminator; returns
+// the length the whole output would have had.
+int vsnprintf(char *str, size_t size, const char *format, va_list args);
+int snprintf(char *str, size_t size, const char *format, ...);
+
+int vsprintf(char *str, const char *format, va_list args);
 int sprintf(char *str, const char *format, ...);
+
+// Output streams. Bytes collect in the stream's buffer and reach the
+// device in one write() when it fills, on fflush(), or sooner as the
+// mode asks. A stream without a buffer writes straight through.
+#define STREAM_FULL 0           // Only when full or flushed
+#define STREAM_LINE 1           // Also after each newline
+#define STREAM_CALL 2           // Also at the end of every call
+
+typedef struct stream stream_t;
+typedef void (*stream_write_t)(stream_t *stream, const char *data, size_t len);
+typedef void (*stream_sync_t)(stream_t *stream);
+
+struct stream {
+    stream_write_t write;
+    stream_sync_t sync;         // Optional, runs at the end of fflush()
+    void *ctx;
+    char *buf;
+    size_t size;
+    size_t len;
+    uint8_t mode;
+    bool error;                 // Set by write() when output was lost
+};
+
+void stream_init(stream_t *stream, stream_write_t write, void *ctx,
+                 char *buf, size_t size, uint8_t mode);
+
+// Unbuffered stream over a string_buf_t; output is truncated like
+// snprintf and buf is kept terminated.
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t pos;
+} string_buf_t;
+
+void stream_open_string(stream_t *stream, string_buf_t *str, char *buf, size_t size);
+
+// Both console streams draw on the VGA text screen and flush at the
+// end of every call, so colour changes in between stay in order.
+extern stream_t console_out;
+extern stream_t console_err;
+extern stream_t *stdout;
+extern stream_t *stderr;
+
+void stream_write(stream_t *stream, const void *data, size_t len);
+int fflush(stream_t *stream);
+int fputc(int c, stream_t *stream);
+int fputs(const char *str, stream_t *stream);
+int vfprintf(stream_t *stream, const char *format, va_list args);
+int fprintf(stream_t *stream, const char *format, ...);
+
+int vprintf(const char *format, va_list args);
+int printf(const char *format, ...);
 void putchar(char c);
 
 #endif
@@ -1,9 +1,73 @@
 #include "string.h"
 
+// Word access to memory of any type; keeps -O2 aliasing rules honest.
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+// Below this many bytes the setup cost of rep movsd/stosd outweighs it.
+#define REP_THRESHOLD 64
+
+#define ONES  0x01010101u
+#define HIGHS 0x80808080u
+#define HAS_ZERO_BYTE(w) (((w) - ONES) & ~(w) & HIGHS)
+
+// SSE2 register types for the vector kernels; both may alias any data.
+// The _u type is for unaligned loads.
+typedef char v16qi __attribute__((vector_size(16), may_alias));
+typedef char v16qi_u __attribute__((vector_size(16), aligned(1), may_alias));
+#define SSE2 __attribute__((target("sse2")))
+#define BROADCAST16(c) { c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c }
+
+// Baseline variants run on any i386. string_select() swaps in faster
+// ones once the CPU has been probed; until then these are used.
+static void *memcpy_i386(void *dest, const void *src, size_t n);
+static void *memset_i386(void *s, int c, size_t n);
+static int memcmp_i386(const void *s1, const void *s2, size_t n);
+static size_t strlen_i386(const char *str);
+static void *memchr_i386(const void *s, int c, size_t n);
+static void *memmem_i386(const void *h, size_t hlen, const void *nd, size_t nlen);
+
+static void *(*memcpy_impl)(void*, const void*, size_t) = memcpy_i386;
+static void *(*memset_impl)(void*, int, size_t) = memset_i386;
+static int (*memcmp_impl)(const void*, const void*, size_t) = memcmp_i386;
+static size_t (*strlen_impl)(const char*) = strlen_i386;
+static void *(*memchr_impl)(const void*, int, size_t) = memchr_i386;
+static void *(*memmem_impl)(const void*, size_t, const void*, size_t) = memmem_i386;
+static string_impls_t impl_names = { "i386", "i386", "i386", "i386", "i386", "i386" };
+
+static size_t strlen_i386(const char *str) {
+    const char *p = str;
+    while ((uint32_t)p & 3) {
+        if (!*p) return p - str;
+        p++;
+    }
+
+    // Aligned loads never cross into the next page, so reading past
+    // the terminator inside the last word is safe.
+    const word_t *w = (const word_t*)p;
+    while (!HAS_ZERO_BYTE(*w)) w++;
+
+    p = (const char*)w;
+    while (*p) p++;
+    return p - str;
+}
+
+// Same page argument as strlen_i386: start from the aligned block that
+// holds str and mask off the lanes before it.
+static SSE2 size_t strlen_sse2(const char *str) {
+    const char *block = (const char*)((uint32_t)str & ~15u);
+    v16qi zero = BROADCAST16(0);
+
+    uint32_t mask = __builtin_ia32_pmovmskb128((v16qi)(*(const v16qi*)block == zero));
+    mask &= 0xFFFFu << (str - block);
+    while (!mask) {
+        block += 16;
+        mask = __builtin_ia32_pmovmskb128((v16qi)(*(const v16qi*)block == zero));
+    }
+    return block + __builtin_ctz(mask) - str;
+}
+
 size_t strlen(const char *str) {
-    size_t len = 0;
-    while (str[len]) len++;
-    return len;
+    return strlen_impl(str);
 }
 
 int strcmp(const char *s1, const char *s2) {
@@ -27,15 +91,350 @@ char *strcat(char *dest, const char *src) {
     return ret;
 }
 
-void *memcpy(void *dest, const void *src, size_t n) {
-    char *d = dest;
-    const char *s = src;
+int strncmp(const char *s1, const char *s2, size_t n) {
+    for (; n; n--, s1++, s2++) {
+        if (*s1 != *s2) return *(unsigned char*)s1 - *(unsigned char*)s2;
+        if (!*s1) break;
+    }
+    return 0;
+}
+
+size_t strlcpy(char *dest, const char *src, size_t size) {
+    size_t len = strlen_impl(src);
+    if (size) {
+        size_t copy = len < size ? len : size - 1;
+        memcpy_impl(dest, src, copy);
+        dest[copy] = '\0';
+    }
+    return len;
+}
+
+size_t strlcat(char *dest, const char *src, size_t size) {
+    size_t used = 0;
+    while (used < size && dest[used]) used++;
+    if (used == size) return size + strlen_impl(src);
+    return used + strlcpy(dest + used, src, size - used);
+}
+
+size_t path_join(char *dest, size_t size, const char *dir, const char *name) {
+    size_t len = strlcpy(dest, dir, size);
+    if (len == 0 || dir[len - 1] != '/') {
+        if (len + 1 < size) {
+            dest[len] = '/';
+            dest[len + 1] = '\0';
+        }
+        len++;
+    }
+    if (len >= size) return len + strlen_impl(name);
+    return len + strlcpy(dest + len, name, size - len);
+}
+
+static void *copy_small(uint8_t *d, const uint8_t *s, size_t n) {
+    void *dest = d;
+    if ((((uint32_t)d | (uint32_t)s) & 3) == 0) {
+        while (n >= 4) {
+            *(word_t*)d = *(const word_t*)s;
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+    }
     while (n--) *d++ = *s++;
     return dest;
 }
 
-void *memset(void *s, int c, size_t n) {
-    unsigned char *p = s;
-    while (n--) *p++ = (unsigned char)c;
+static void *memcpy_i386(void *dest, const void *src, size_t n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    if (n < REP_THRESHOLD) return copy_small(d, s, n);
+
+    // Align the destination, move whole words, then the tail
+    size_t head = -(uint32_t)d & 3;
+    size_t words = (n - head) >> 2;
+    size_t tail = (n - head) & 3;
+    __asm__ volatile("rep movsb\n\t"
+                     "mov %3, %%ecx\n\t"
+                     "rep movsl\n\t"
+                     "mov %4, %%ecx\n\t"
+                     "rep movsb"
+                     : "+D"(d), "+S"(s), "+c"(head)
+                     : "r"(words), "r"(tail)
+                     : "memory");
+    return dest;
+}
+
+// With ERMS the microcode picks the widest moves itself, so a single
+// rep movsb beats splitting the copy into head, words and tail.
+static void *memcpy_erms(void *dest, const void *src, size_t n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    if (n < REP_THRESHOLD) return copy_small(d, s, n);
+
+    __asm__ volatile("rep movsb"
+                     : "+D"(d), "+S"(s), "+c"(n)
+                     :
+                     : "memory");
+    return dest;
+}
+
+void *memcpy(void *dest, const void *src, size_t n) {
+    return memcpy_impl(dest, src, n);
+}
+
+void *memmove(void *dest, const void *src, size_t n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    if (d == s || n == 0) return dest;
+
+    // Disjoint ranges can take the fast path
+    if (d + n <= s || s + n <= d) return memcpy_impl(dest, src, n);
+
+    if (d < s) {
+        while (n--) *d++ = *s++;
+    } else {
+        d += n;
+        s += n;
+        while (n && ((uint32_t)d & 3)) {
+            *--d = *--s;
+            n--;
+        }
+        while (n >= 4) {
+            d -= 4;
+            s -= 4;
+            *(word_t*)d = *(const word_t*)s;
+            n -= 4;
+        }
+        while (n--) *--d = *--s;
+    }
+    return dest;
+}
+
+static void *set_small(uint8_t *p, uint8_t c, size_t n) {
+    void *s = p;
+    uint32_t fill = c * ONES;
+    while (n && ((uint32_t)p & 3)) {
+        *p++ = c;
+        n--;
+    }
+    while (n >= 4) {
+        *(word_t*)p = fill;
+        p += 4;
+        n -= 4;
+    }
+    while (n--) *p++ = c;
+    return s;
+}
+
+static void *memset_i386(void *s, int c, size_t n) {
+    uint8_t *p = s;
+    if (n < REP_THRESHOLD) return set_small(p, (uint8_t)c, n);
+
+    uint32_t fill = (uint8_t)c * ONES;
+    size_t head = -(uint32_t)p & 3;
+    size_t words = (n - head) >> 2;
+    size_t tail = (n - head) & 3;
+    __asm__ volatile("rep stosb\n\t"
+                     "mov %3, %%ecx\n\t"
+                     "rep stosl\n\t"
+                     "mov %4, %%ecx\n\t"
+                     "rep stosb"
+                     : "+D"(p), "+c"(head)
+                     : "a"(fill), "r"(words), "r"(tail)
+                     : "memory");
     return s;
 }
+
+static void *memset_erms(void *s, int c, size_t n) {
+    uint8_t *p = s;
+    if (n < REP_THRESHOLD) return set_small(p, (uint8_t)c, n);
+
+    __asm__ volatile("rep stosb"
+                     : "+D"(p), "+c"(n)
+                     : "a"(c)
+                     : "memory");
+    return s;
+}
+
+void *memset(void *s, int c, size_t n) {
+    return memset_impl(s, c, n);
+}
+
+static int memcmp_i386(const void *s1, const void *s2, size_t n) {
+    const uint8_t *a = s1;
+    const uint8_t *b = s2;
+
+    // Skip equal words, then let the byte loop find the difference
+    while (n >= 4 && *(const word_t*)a == *(const word_t*)b) {
+        a += 4;
+        b += 4;
+        n -= 4;
+    }
+    while (n--) {
+        if (*a != *b) return *a - *b;
+        a++;
+        b++;
+    }
+    return 0;
+}
+
+static SSE2 int memcmp_sse2(const void *s1, const void *s2, size_t n) {
+    const uint8_t *a = s1;
+    const uint8_t *b = s2;
+
+    while (n >= 16) {
+        v16qi va = *(const v16qi_u*)a;
+        v16qi vb = *(const v16qi_u*)b;
+        uint32_t equal = __builtin_ia32_pmovmskb128((v16qi)(va == vb));
+        if (equal != 0xFFFF) {
+            int i = __builtin_ctz(~equal);
+            return a[i] - b[i];
+        }
+        a += 16;
+        b += 16;
+        n -= 16;
+    }
+    return memcmp_i386(a, b, n);
+}
+
+int memcmp(const void *s1, const void *s2, size_t n) {
+    return memcmp_impl(s1, s2, n);
+}
+
+static void *memchr_i386(const void *s, int c, size_t n) {
+    const uint8_t *p = s;
+    uint8_t ch = (uint8_t)c;
+
+    while (n && ((uint32_t)p & 3)) {
+        if (*p == ch) return (void*)p;
+        p++;
+        n--;
+    }
+
+    // A byte equal to ch becomes zero after the xor
+    uint32_t pattern = ch * ONES;
+    while (n >= 4) {
+        uint32_t w = *(const word_t*)p ^ pattern;
+        if (HAS_ZERO_BYTE(w)) break;
+        p += 4;
+        n -= 4;
+    }
+
+    while (n--) {
+        if (*p == ch) return (void*)p;
+        p++;
+    }
+    return NULL;
+}
+
+// Aligned 16-byte loads never cross a page, so the first and last blocks
+// may read outside [s, s + n); those lanes are masked off.
+static SSE2 void *memchr_sse2(const void *s, int c, size_t n) {
+    if (n == 0) return NULL;
+    const uint8_t *p = s;
+    const uint8_t *end = p + n;
+    const uint8_t *block = (const uint8_t*)((uint32_t)p & ~15u);
+    v16qi needle = BROADCAST16((char)c);
+
+    uint32_t mask = __builtin_ia32_pmovmskb128((v16qi)(*(const v16qi*)block == needle));
+    mask &= 0xFFFFu << (p - block);
+    for (;;) {
+        if (mask) {
+            const uint8_t *hit = block + __builtin_ctz(mask);
+            return hit < end ? (void*)hit : NULL;
+        }
+        block += 16;
+        if (block >= end) return NULL;
+        mask = __builtin_ia32_pmovmskb128((v16qi)(*(const v16qi*)block == needle));
+    }
+}
+
+void *memchr(const void *s, int c, size_t n) {
+    return memchr_impl(s, c, n);
+}
+
+static void *memmem_i386(const void *h, size_t hlen, const void *nd, size_t nlen) {
+    const uint8_t *hay = h;
+    const uint8_t *needle = nd;
+    if (nlen == 0) return (void*)hay;
+    if (nlen > hlen) return NULL;
+
+    const uint8_t *last = hay + hlen - nlen;
+    while (hay <= last) {
+        hay = memchr_impl(hay, needle[0], last - hay + 1);
+        if (!hay) return NULL;
+        if (memcmp_impl(hay + 1, needle + 1, nlen - 1) == 0) return (void*)hay;
+        hay++;
+    }
+    return NULL;
+}
+
+// Compares the needle's first and last byte against 16 candidate
+// positions at once; only positions where both match get a full compare.
+static SSE2 void *memmem_sse2(const void *h, size_t hlen, const void *nd, size_t nlen) {
+    const uint8_t *hay = h;
+    const uint8_t *needle = nd;
+    if (nlen < 2 || nlen > hlen) return memmem_i386(h, hlen, nd, nlen);
+
+    v16qi first = BROADCAST16((char)needle[0]);
+    v16qi last = BROADCAST16((char)needle[nlen - 1]);
+    size_t i = 0;
+
+    for (; i + nlen - 1 + 16 <= hlen; i += 16) {
+        v16qi block_first = *(const v16qi_u*)(hay + i);
+        v16qi block_last = *(const v16qi_u*)(hay + i + nlen - 1);
+        uint32_t mask = __builtin_ia32_pmovmskb128(
+            (v16qi)((block_first == first) & (block_last == last)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (memcmp_impl(hay + i + bit + 1, needle + 1, nlen - 2) == 0) {
+                return (void*)(hay + i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+    return memmem_i386(hay + i, hlen - i, needle, nlen);
+}
+
+void *memmem(const void *haystack, size_t hlen, const void *needle, size_t nlen) {
+    return memmem_impl(haystack, hlen, needle, nlen);
+}
+
+char *strstr(const char *haystack, const char *needle) {
+    return memmem_impl(haystack, strlen_impl(haystack), needle, strlen_impl(needle));
+}
+
+void string_select(uint32_t caps) {
+    memcpy_impl = memcpy_i386;
+    memset_impl = memset_i386;
+    memcmp_impl = memcmp_i386;
+    strlen_impl = strlen_i386;
+    memchr_impl = memchr_i386;
+    memmem_impl = memmem_i386;
+    impl_names.memcpy = "i386";
+    impl_names.memset = "i386";
+    impl_names.memcmp = "i386";
+    impl_names.strlen = "i386";
+    impl_names.memchr = "i386";
+    impl_names.memmem = "i386";
+
+    if (caps & STRING_CAP_ERMS) {
+        memcpy_impl = memcpy_erms;
+        memset_impl = memset_erms;
+        impl_names.memcpy = "erms";
+        impl_names.memset = "erms";
+    }
+    if (caps & STRING_CAP_SSE2) {
+        memcmp_impl = memcmp_sse2;
+        strlen_impl = strlen_sse2;
+        memchr_impl = memchr_sse2;
+        memmem_impl = memmem_sse2;
+        impl_names.memcmp = "sse2";
+        impl_names.strlen = "sse2";
+        impl_names.memchr = "sse2";
+        impl_names.memmem = "sse2";
+    }
+}
+
+void string_get_impls(string_impls_t *impls) {
+    *impls = impl_names;
+}
@@ -9,5 +9,38 @@ char *strcpy(char *dest, const char *src);
 char *strcat(char *dest, const char *src);
 void *memcpy(void *dest, const void *src, size_t n);
 void *memset(void *s, int c, size_t n);
+int memcmp(const void *s1, const void *s2, size_t n);
+void *memchr(const void *s, int c, size_t n);
+void *memmem(const void *haystack, size_t hlen, const void *needle, size_t nlen);
+char *strstr(const char *haystack, const char *needle);
+int strncmp(const char *s1, const char *s2, size_t n);
+void *memmove(void *dest, const void *src, size_t n);
+
+// Bounded copies: dest is always terminated (when size > 0) and the
+// return value is the length the full result would have. A return of
+// size or more means the result was truncated.
+size_t strlcpy(char *dest, const char *src, size_t size);
+size_t strlcat(char *dest, const char *src, size_t size);
+
+// Writes dir + "/" + name into dest, without doubling the slash when dir
+// is "/" or ends in one. Returns the length like strlcpy does.
+size_t path_join(char *dest, size_t size, const char *dir, const char *name);
+
+// CPU capabilities that string_select() can take advantage of.
+#define STRING_CAP_ERMS (1 << 0)
+#define STRING_CAP_SSE2 (1 << 1)    // Only with SSE state enabled (CR4.OSFXSR)
+
+// Name of the variant currently behind each dispatched routine.
+typedef struct {
+    const char *memcpy;
+    const char *memset;
+    const char *memcmp;
+    const char *strlen;
+    const char *memchr;
+    const char *memmem;
+} string_impls_t;
+
+void string_select(uint32_t caps);
+void string_get_impls(string_impls_t *impls);
 
 #endif
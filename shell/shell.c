@@ -10,6 +10,13 @@
 #include "../lib/string/string.h"
 #include "../kernel/timer.h"
 #include "../kernel/memory.h"
+#include "../kernel/pmm.h"
+#include "../kernel/paging.h"
+#include "../kernel/slab.h"
+#include "../kernel/arena.h"
+#include "../kernel/cpu.h"
+#include "../kernel/fpu.h"
+#include "../kernel/klog.h"
 #include "../kernel/kernel.h"
 #include "../fs/simfs/simfs.h"
 
@@ -17,58 +24,31 @@
 #define MAX_HISTORY 10
 #define SCREEN_HEIGHT 25
 #define SCREEN_WIDTH 80
+#define SCRATCH_SIZE 0x10000    // Per-command scratch, reset after each command
 
 static char input_buffer[BUFFER_SIZE];
 static char history[MAX_HISTORY][BUFFER_SIZE];
 static int history_count = 0;
+static arena_t scratch;
+static simfs_stream_t redirect_file;
+static bool console_welcomed[VGA_CONSOLES];
 
-static void itoa_custom(int num, char* str) {
-    int i = 0;
-    int is_negative = 0;
-    
-    if (num == 0) {
-        str[0] = '0';
-        str[1] = '\0';
-        return;
-    }
-    
-    if (num < 0) {
-        is_negative = 1;
-        num = -num;
-    }
-    
-    while (num != 0) {
-        int rem = num % 10;
-        str[i++] = rem + '0';
-        num = num / 10;
-    }
-    
-    if (is_negative) {
-        str[i++] = '-';
-    }
-    
-    str[i] = '\0';
-    
-    int start = 0;
-    int end = i - 1;
-    while (start < end) {
-        char temp = str[start];
-        str[start] = str[end];
-        str[end] = temp;
-        start++;
-        end--;
+// Temporary buffers for the running command. They live until
+// execute_command returns, which keeps big arrays off the 16 KB stack.
+static void *scratch_alloc(size_t size) {
+    void *ptr = arena_alloc(&scratch, size);
+    if (!ptr) {
+        printf("shell: out of scratch memory\n");
     }
+    return ptr;
 }
 
 static void print_int(int num) {
-    char buffer[20];
-    itoa_custom(num, buffer);
-    printf("%s", buffer);
+    printf("%d", num);
 }
 
 static void print_int_padded(int num) {
-    if (num < 10) printf("0");
-    print_int(num);
+    printf("%02d", num);
 }
 
 static void show_welcome(void) {
@@ -80,15 +60,24 @@ static void show_welcome(void) {
     printf("  Type 'help' for available commands\n\n");
 }
 
+// Escape codes only mean something to the console; redirected output
+// and the serial stream get the plain text.
+static const char *color(const stream_t *stream, const char *code) {
+    return stream == &console_out || stream == &console_err ? code : "";
+}
+
+static void print_heading(const char *title) {
+    printf("\n%s%s\n%s--------------------------------%s\n", color(stdout, ANSI_LIGHT_CYAN),
+           title, color(stdout, ANSI_YELLOW), color(stdout, ANSI_RESET));
+}
+
+static void print_subheading(const char *title) {
+    printf("\n%s%s%s\n", color(stdout, ANSI_LIGHT_CYAN), title, color(stdout, ANSI_RESET));
+}
+
 static void show_prompt(void) {
-    vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
-    printf("lexos");
-    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
-    printf(":");
-    vga_set_color(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
-    printf("%s", simfs_get_cwd());
-    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-    printf("$ ");
+    printf("%slexos%s:%s%s%s$ ", color(stdout, ANSI_LIGHT_GREEN), color(stdout, ANSI_WHITE),
+           color(stdout, ANSI_LIGHT_BLUE), simfs_get_cwd(), color(stdout, ANSI_RESET));
 }
 
 static char wait_for_key(void) {
@@ -118,6 +107,12 @@ static void cmd_help(void) {
         "  uptime    - Show system uptime",
         "  date      - Display current date/time",
         "  free      - Display memory usage",
+        "  slabinfo  - Show object cache usage",
+        "  memstat   - Show live heap telemetry",
+        "  memleaks  - Outstanding allocations by call site",
+        "  cpuinfo   - Show CPU features and string routines",
+        "  dmesg     - Show the kernel log",
+        "  mirror    - Mirror the screen to COM1 [on|off]",
         "  clear     - Clear the screen",
         "",
         "File & Directory:",
@@ -136,12 +131,16 @@ static void cmd_help(void) {
         "  echo <t>  - Print text to screen",
         "  calc      - Simple calculator",
         "  history   - Show command history",
+        "  cmd > f   - Write output to file f (>> appends)",
+        "  cmd > /dev/serial - Send output to COM1",
         "",
         "System Control:",
         "  reboot    - Reboot the system",
         "  halt      - Halt the system",
         "",
         "Navigation: Arrow Up/Down, Page Up/Down",
+        "Shift+PgUp/PgDn scrolls back through console output",
+        "Alt+F1..F4 switch between virtual consoles",
         "Press ESC to exit help",
         "",
         NULL
@@ -150,6 +149,12 @@ static void cmd_help(void) {
     int total_lines = 0;
     while (help_lines[total_lines] != NULL) total_lines++;
     
+    // Redirected: the whole text, no pager
+    if (stdout != &console_out) {
+        for (int i = 0; i < total_lines; i++) printf("%s\n", help_lines[i]);
+        return;
+    }
+    
     int scroll_pos = 0;
     int max_lines = SCREEN_HEIGHT - 3;
     
@@ -285,33 +290,202 @@ static void cmd_free(void) {
     uint32_t total = 0, used = 0, free_mem = 0;
     memory_stats(&total, &used, &free_mem);
     
-    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
-    printf("\nMemory Usage:\n");
-    vga_set_color(VGA_COLOR_YELLOW, VGA_COLOR_BLACK);
-    printf("--------------------------------\n");
-    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    print_heading("Memory Usage:");
     
-    printf("  Total: ");
-    print_int(total / 1024);
-    printf(" KB\n");
-    printf("  Used:  ");
-    print_int(used / 1024);
-    printf(" KB\n");
-    printf("  Free:  ");
-    print_int(free_mem / 1024);
-    printf(" KB\n");
+    printf("  Total: %u KB\n", total / 1024);
+    printf("  Used:  %u KB\n", used / 1024);
+    printf("  Free:  %u KB\n", free_mem / 1024);
     
     if (total > 0) {
         uint32_t used_percent = (used * 100) / total;
-        printf("\nUsage: ");
-        print_int(used_percent);
-        printf("%%\n");
+        printf("\nUsage: %u%%\n", used_percent);
     }
+
+    uint32_t frames = 0, free_frames = 0;
+    pmm_stats(&frames, &free_frames);
+    printf("\nPhysical: %u KB usable, %u KB free\n",
+           frames * (PAGE_SIZE / 1024), free_frames * (PAGE_SIZE / 1024));
+
+    uint32_t reserved = 0, committed = 0;
+    paging_heap_stats(&reserved, &committed);
+    printf("Heap:     %u KB reserved, %u KB committed\n", reserved / 1024, committed / 1024);
+
+    print_subheading("Size Classes (size: allocs / hits / cached):");
+    for (int i = 0; i < MEM_NUM_CLASSES; i++) {
+        mem_class_stats_t cls;
+        memory_class_stats(i, &cls);
+        printf("  %u: %u / %u / %u\n", cls.size, cls.allocs, cls.hits, cls.cached);
+    }
+}
+
+static void cmd_memstat(void) {
+    static uint32_t last_ticks = 0;
+    static uint32_t last_allocs = 0;
+
+    mem_telemetry_t t;
+    memory_telemetry(&t);
+    uint32_t ticks = timer_get_ticks();
+
+    print_heading("Heap Telemetry:");
+
+    printf("  Heap:    %u KB\n", t.heap_total / 1024);
+    printf("  Current: %u bytes\n", t.current_bytes);
+    printf("  Peak:    %u bytes\n", t.peak_bytes);
+    printf("  Allocs:  %u\n", t.alloc_count);
+    printf("  Frees:   %u\n", t.free_count);
+    printf("  Live:    %u\n", t.alloc_count - t.free_count);
+    printf("  Failed:  %u\n", t.failed_count);
+
+    // Rate over the interval since the previous memstat
+    if (last_ticks && ticks > last_ticks) {
+        uint32_t rate = (t.alloc_count - last_allocs) * timer_get_frequency() / (ticks - last_ticks);
+        printf("  Rate:    %u allocs/s since last memstat\n", rate);
+    }
+    last_ticks = ticks;
+    last_allocs = t.alloc_count;
+
+    print_subheading("Request sizes (bytes: count):");
+    for (int i = 0; i < MEM_HIST_BUCKETS; i++) {
+        if (t.histogram[i] == 0) continue;
+        printf("  %u+: %u\n", 1u << i, t.histogram[i]);
+    }
+}
+
+static void cmd_memleaks(void) {
+    static mem_site_t sites[32];
+    int count = memory_leak_report(sites, 32);
+
+    if (count < 0) {
+        printf("memleaks: kernel built without KMALLOC_TRACE=1\n");
+        return;
+    }
+
+    print_heading("Outstanding allocations by call site:");
+
+    // Largest owners first
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            if (sites[j].bytes > sites[i].bytes) {
+                mem_site_t temp = sites[i];
+                sites[i] = sites[j];
+                sites[j] = temp;
+            }
+        }
+    }
+
+    uint32_t total_blocks = 0, total_bytes = 0;
+    for (int i = 0; i < count; i++) {
+        printf("  0x%x %s: %u blocks, %u bytes\n", (uint32_t)sites[i].caller, sites[i].tag,
+               sites[i].count, sites[i].bytes);
+        total_blocks += sites[i].count;
+        total_bytes += sites[i].bytes;
+    }
+
+    printf("\nTotal: %u blocks, %u bytes in %d call site(s)\n", total_blocks, total_bytes, count);
+}
+
+static void cmd_slabinfo(void) {
+    print_heading("Object Caches (name: objsize/stride, active/total, slabs, use):");
+
+    kmem_cache_stats_t stats;
+    int index = 0;
+    while (kmem_cache_stats(index, &stats) == 0) {
+        printf("  %s: %u/%u, %u/%u, %u slabs, %u%%\n", stats.name, stats.object_size,
+               stats.stride, stats.active, stats.total, stats.slabs,
+               stats.total ? stats.active * 100 / stats.total : 0);
+        index++;
+    }
+
+    if (index == 0) {
+        printf("  (no caches)\n");
+    }
+}
+
+static void cmd_cpuinfo(void) {
+    static const struct {
+        uint32_t flag;
+        const char *name;
+    } features[] = {
+        { CPU_FEATURE_FPU, "fpu" },
+        { CPU_FEATURE_TSC, "tsc" },
+        { CPU_FEATURE_APIC, "apic" },
+        { CPU_FEATURE_FXSR, "fxsr" },
+        { CPU_FEATURE_SSE, "sse" },
+        { CPU_FEATURE_SSE2, "sse2" },
+        { CPU_FEATURE_ERMS, "erms" },
+    };
+    const cpu_info_t *cpu = cpu_get_info();
+
+    print_heading("Processor:");
+
+    if (!cpu->has_cpuid) {
+        printf("  No CPUID instruction (pre-586 CPU)\n");
+    } else {
+        printf("  Vendor:   %s\n", cpu->vendor);
+        if (cpu->brand[0]) printf("  Model:    %s\n", cpu->brand);
+        printf("  Family:   %u, model %u, stepping %u\n", cpu->family, cpu->model, cpu->stepping);
+        printf("  Features:");
+        for (size_t i = 0; i < sizeof(features) / sizeof(features[0]); i++) {
+            if (cpu_has(features[i].flag)) printf(" %s", features[i].name);
+        }
+        const char *simd = "none";
+        if (fpu_sse_enabled()) simd = "x87 + SSE";
+        else if (cpu_has(CPU_FEATURE_FPU)) simd = "x87";
+        printf("\n  SIMD:     %s, %u lazy saves in interrupts\n", simd, fpu_lazy_saves());
+    }
+
+    string_impls_t impls;
+    string_get_impls(&impls);
+    print_subheading("String routines:");
+    printf("  memcpy: %s\n", impls.memcpy);
+    printf("  memset: %s\n", impls.memset);
+    printf("  memcmp: %s\n", impls.memcmp);
+    printf("  strlen: %s\n", impls.strlen);
+    printf("  memchr: %s\n", impls.memchr);
+    printf("  memmem: %s\n", impls.memmem);
+}
+
+static void cmd_dmesg(void) {
+    static const char *level_colors[] = {
+        ANSI_LIGHT_RED, ANSI_YELLOW, ANSI_RESET, ANSI_DARK_GREY
+    };
+    uint32_t hz = timer_get_frequency();
+    uint32_t end = klog_next_seq();
+    klog_entry_t entry;
+
+    for (uint32_t seq = klog_first_seq(); seq != end; seq++) {
+        if (!klog_read(seq, &entry)) continue;
+        uint32_t secs = hz ? entry.ticks / hz : 0;
+        uint32_t hundredths = hz ? (entry.ticks % hz) * 100 / hz : 0;
+        printf("%s[%5u.%02u] %s%s%s\n", color(stdout, ANSI_GREEN), secs, hundredths,
+               color(stdout, level_colors[entry.level & 3]), entry.text, color(stdout, ANSI_RESET));
+    }
+}
+
+static void cmd_mirror(const char *args) {
+    if (strcmp(args, "on") == 0) {
+        klog_set_serial(false);
+        vga_mirror_enable(true);
+        if (!vga_mirror_enabled()) {
+            klog_set_serial(true);
+            printf("mirror: no serial port\n");
+            return;
+        }
+    } else if (strcmp(args, "off") == 0) {
+        vga_mirror_enable(false);
+        klog_set_serial(true);
+    } else if (args[0] != '\0') {
+        printf("Usage: mirror [on|off]\n");
+        return;
+    }
+    printf("mirror: %s, %u bytes sent\n", vga_mirror_enabled() ? "on" : "off",
+           vga_mirror_bytes());
 }
 
 static void cmd_ls(void) {
-    char names[64][SIMFS_MAX_NAME];
-    simfs_type_t types[64];
+    char (*names)[SIMFS_MAX_NAME] = scratch_alloc(64 * SIMFS_MAX_NAME);
+    simfs_type_t *types = scratch_alloc(64 * sizeof(simfs_type_t));
+    if (!names || !types) return;
     
     int count = simfs_list_dir(NULL, names, types, 64);
     
@@ -363,9 +537,8 @@ static void cmd_mkdir(const char *args) {
     
     int result = simfs_mkdir(args);
     if (result == 0) {
-        vga_set_color(VGA_COLOR_YELLOW, VGA_COLOR_BLACK);
-        printf("mkdir: created '%s'\n", args);
-        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        printf("%smkdir: created '%s'%s\n",
+               color(stdout, ANSI_YELLOW), args, color(stdout, ANSI_RESET));
     } else if (result == -2) {
         printf("mkdir: cannot create directory '%s': Already exists\n", args);
     } else {
@@ -381,9 +554,8 @@ static void cmd_rmdir(const char *args) {
     
     int result = simfs_rmdir(args);
     if (result == 0) {
-        vga_set_color(VGA_COLOR_YELLOW, VGA_COLOR_BLACK);
-        printf("rmdir: removed '%s'\n", args);
-        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        printf("%srmdir: removed '%s'%s\n",
+               color(stdout, ANSI_YELLOW), args, color(stdout, ANSI_RESET));
     } else if (result == -2) {
         printf("rmdir: cannot remove '%s': Directory not empty\n", args);
     } else {
@@ -399,9 +571,8 @@ static void cmd_touch(const char *args) {
     
     int result = simfs_touch(args);
     if (result == 0) {
-        vga_set_color(VGA_COLOR_YELLOW, VGA_COLOR_BLACK);
-        printf("touch: created file '%s'\n", args);
-        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        printf("%stouch: created file '%s'%s\n",
+               color(stdout, ANSI_YELLOW), args, color(stdout, ANSI_RESET));
     } else if (result == -2) {
         printf("touch: '%s' already exists\n", args);
     } else {
@@ -415,7 +586,8 @@ static void cmd_cat(const char *args) {
         return;
     }
     
-    char buffer[SIMFS_MAX_CONTENT];
+    char *buffer = scratch_alloc(SIMFS_MAX_CONTENT);
+    if (!buffer) return;
     int result = simfs_read_file(args, buffer, SIMFS_MAX_CONTENT);
     
     if (result >= 0) {
@@ -436,9 +608,8 @@ static void cmd_rm(const char *args) {
     }
     
     if (simfs_rm(args) == 0) {
-        vga_set_color(VGA_COLOR_YELLOW, VGA_COLOR_BLACK);
-        printf("rm: removed '%s'\n", args);
-        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        printf("%srm: removed '%s'%s\n",
+               color(stdout, ANSI_YELLOW), args, color(stdout, ANSI_RESET));
     } else {
         printf("rm: cannot remove '%s': No such file\n", args);
     }
@@ -471,8 +642,10 @@ static void cmd_write(const char *args) {
     }
     filename[j] = '\0';
     
-    char existing_content[SIMFS_MAX_CONTENT] = {0};
-    simfs_read_file(filename, existing_content, SIMFS_MAX_CONTENT);
+    char *buffer = scratch_alloc(SIMFS_MAX_CONTENT);
+    if (!buffer) return;
+    buffer[0] = '\0';
+    simfs_read_file(filename, buffer, SIMFS_MAX_CONTENT);
     
     vga_clear();
     vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
@@ -484,8 +657,6 @@ static void cmd_write(const char *args) {
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     printf("-------------------------------------\n");
     
-    char buffer[SIMFS_MAX_CONTENT];
-    strcpy(buffer, existing_content);
     int pos = strlen(buffer);
     printf("%s", buffer);
     
@@ -545,8 +716,9 @@ static void cmd_tree(void) {
     printf("%s\n", simfs_get_cwd());
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     
-    char names[64][SIMFS_MAX_NAME];
-    simfs_type_t types[64];
+    char (*names)[SIMFS_MAX_NAME] = scratch_alloc(64 * SIMFS_MAX_NAME);
+    simfs_type_t *types = scratch_alloc(64 * sizeof(simfs_type_t));
+    if (!names || !types) return;
     int count = simfs_list_dir(NULL, names, types, 64);
     
     int dir_count = 0, file_count = 0;
@@ -710,13 +882,46 @@ static void add_to_history(const char *cmd) {
     if (cmd[0] == '\0') return;
     
     if (history_count < MAX_HISTORY) {
-        strcpy(history[history_count++], cmd);
+        strlcpy(history[history_count++], cmd, BUFFER_SIZE);
     } else {
-        for (int i = 0; i < MAX_HISTORY - 1; i++) {
-            strcpy(history[i], history[i + 1]);
-        }
-        strcpy(history[MAX_HISTORY - 1], cmd);
+        memmove(history[0], history[1], (MAX_HISTORY - 1) * BUFFER_SIZE);
+        strlcpy(history[MAX_HISTORY - 1], cmd, BUFFER_SIZE);
+    }
+}
+
+static void trim_trailing_spaces(char *str) {
+    size_t len = strlen(str);
+    while (len > 0 && str[len - 1] == ' ') str[--len] = '\0';
+}
+
+// Strips "> target" or ">> target" off line and points stdout at the
+// target: a simfs file, or the serial port for /dev/serial. Returns -1
+// if the target cannot be opened.
+static int redirect_stdout(char *line) {
+    char *mark = memchr(line, '>', strlen(line));
+    if (!mark) return 0;
+    
+    bool append = mark[1] == '>';
+    char *target = mark + (append ? 2 : 1);
+    *mark = '\0';
+    trim_trailing_spaces(line);
+    while (*target == ' ') target++;
+    trim_trailing_spaces(target);
+    
+    if (target[0] == '\0') {
+        fprintf(stderr, "shell: missing redirect target\n");
+        return -1;
+    }
+    if (strcmp(target, "/dev/serial") == 0) {
+        stdout = serial_out;
+        return 0;
     }
+    if (simfs_open_stream(&redirect_file, target, append) != 0) {
+        fprintf(stderr, "shell: cannot write to %s\n", target);
+        return -1;
+    }
+    stdout = &redirect_file.stream;
+    return 0;
 }
 
 static void execute_command(const char *cmd) {
@@ -724,6 +929,11 @@ static void execute_command(const char *cmd) {
     
     add_to_history(cmd);
     
+    char line[BUFFER_SIZE];
+    strlcpy(line, cmd, sizeof(line));
+    if (redirect_stdout(line) != 0) return;
+    cmd = line;
+    
     char command[32] = {0};
     int i = 0, j = 0;
     
@@ -736,13 +946,20 @@ static void execute_command(const char *cmd) {
     while (cmd[i] == ' ') i++;
     const char *args = &cmd[i];
     
-    if (strcmp(command, "help") == 0) cmd_help();
+    if (command[0] == '\0') { }    // "> file" alone just truncates it
+    else if (strcmp(command, "help") == 0) cmd_help();
     else if (strcmp(command, "clear") == 0) { vga_clear(); show_welcome(); }
     else if (strcmp(command, "info") == 0) cmd_info();
     else if (strcmp(command, "uname") == 0) cmd_uname();
     else if (strcmp(command, "uptime") == 0) cmd_uptime();
     else if (strcmp(command, "date") == 0) cmd_date();
     else if (strcmp(command, "free") == 0) cmd_free();
+    else if (strcmp(command, "slabinfo") == 0) cmd_slabinfo();
+    else if (strcmp(command, "memstat") == 0) cmd_memstat();
+    else if (strcmp(command, "memleaks") == 0) cmd_memleaks();
+    else if (strcmp(command, "cpuinfo") == 0) cmd_cpuinfo();
+    else if (strcmp(command, "dmesg") == 0) cmd_dmesg();
+    else if (strcmp(command, "mirror") == 0) cmd_mirror(args);
     else if (strcmp(command, "tree") == 0) cmd_tree();
     else if (strcmp(command, "ls") == 0) cmd_ls();
     else if (strcmp(command, "pwd") == 0) cmd_pwd();
@@ -759,11 +976,15 @@ static void execute_command(const char *cmd) {
     else if (strcmp(command, "reboot") == 0) cmd_reboot();
     else if (strcmp(command, "halt") == 0) cmd_halt();
     else {
-        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        printf("%s: command not found\n", command);
-        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-        printf("Type 'help' for available commands\n");
+        fprintf(stderr, "%s%s: command not found\n%sType 'help' for available commands\n",
+                color(stderr, ANSI_LIGHT_RED), command, color(stderr, ANSI_RESET));
+    }
+    
+    if (stdout != &console_out) {
+        if (fflush(stdout) != 0) fprintf(stderr, "shell: output truncated\n");
+        stdout = &console_out;
     }
+    arena_reset(&scratch);
 }
 
 static void read_line(char *buffer, size_t max_len) {
@@ -772,6 +993,21 @@ static void read_line(char *buffer, size_t max_len) {
     while (1) {
         char c = keyboard_getchar();
         
+        // Carry the line being typed over to the new console
+        if (c == KEY_CONSOLE_SWITCH) {
+            int index = vga_get_console();
+            if (!console_welcomed[index]) {
+                console_welcomed[index] = true;
+                show_welcome();
+            } else {
+                printf("\n");
+            }
+            show_prompt();
+            buffer[pos] = '\0';
+            printf("%s", buffer);
+            continue;
+        }
+        
         if (c == '\n') {
             buffer[pos] = '\0';
             printf("\n");
@@ -794,7 +1030,9 @@ static void read_line(char *buffer, size_t max_len) {
 }
 
 void shell_init(void) {
+    arena_init(&scratch, SCRATCH_SIZE);
     simfs_init();
+    console_welcomed[vga_get_console()] = true;
     show_welcome();
 }
 
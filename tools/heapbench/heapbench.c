@@ -0,0 +1,383 @@
+/* ================================================
+ * tools/heapbench/heapbench.c - Kernel heap benchmark
+ * Runs kernel/memory.c as a Linux process and replays
+ * synthetic or recorded alloc/free traces against it.
+ *
+ * Trace format, one operation per line:
+ *   a <slot> <size>           kmalloc into slot
+ *   m <slot> <size> <align>   kmalloc_aligned into slot
+ *   r <slot> <size>           krealloc slot
+ *   f <slot>                  kfree slot
+ *
+ * Every pointer handed out is checked for alignment. With -c each
+ * block is also filled with a pattern that is verified on free and
+ * across krealloc; that slows the run, so timings are not comparable.
+ * ================================================ */
+#include "shim.h"
+#include "../../kernel/memory.h"
+#include "../../lib/string/string.h"
+
+#define MAX_SLOTS 65536
+#define DEFAULT_OPS 1000000
+#define DEFAULT_SLOTS 4096
+#define READ_CHUNK 65536
+#define O_RDONLY 0
+#define O_WRONLY_CREAT_TRUNC 01101
+
+typedef struct {
+    char kind;
+    uint32_t slot;
+    uint32_t size;
+    uint32_t align;
+} trace_op_t;
+
+typedef struct {
+    uint64_t ops;
+    uint64_t total_cycles;
+    uint64_t worst_cycles;
+    uint64_t failures;
+    uint64_t check_failures;
+    uint64_t live_bytes;
+    uint64_t peak_live_bytes;
+} bench_result_t;
+
+static void *slots[MAX_SLOTS];
+static uint32_t slot_sizes[MAX_SLOTS];
+static uint8_t slot_seeds[MAX_SLOTS];
+static uint8_t next_seed = 0;
+static bool check_contents = false;
+static uint32_t rng_state = 1;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t parse_u32(const char *s) {
+    uint32_t value = 0;
+    while (*s >= '0' && *s <= '9') {
+        value = value * 10 + (*s++ - '0');
+    }
+    return value;
+}
+
+static void die(const char *message) {
+    put_str(STDERR_FD, "heapbench: ");
+    put_str(STDERR_FD, message);
+    put_str(STDERR_FD, "\n");
+    sys_exit(1);
+}
+
+// Mostly small kernel objects, some buffers and the odd large table.
+static uint32_t synthetic_size(void) {
+    uint32_t pick = rng_next() % 100;
+    if (pick < 70) return 8 + rng_next() % 248;
+    if (pick < 95) return 256 + rng_next() % 7936;
+    return 8192 + rng_next() % 122880;
+}
+
+static void synthetic_op(uint32_t nslots, trace_op_t *op) {
+    op->slot = rng_next() % nslots;
+    op->align = 0;
+    if (!slots[op->slot]) {
+        op->kind = 'a';
+        op->size = synthetic_size();
+        // Now and then a page table or DMA buffer: 16 B to 4 KB alignment
+        if (rng_next() % 16 == 0) {
+            op->kind = 'm';
+            op->align = 16u << (rng_next() % 9);
+        }
+    } else if (rng_next() % 8 == 0) {
+        op->kind = 'r';
+        op->size = synthetic_size();
+    } else {
+        op->kind = 'f';
+        op->size = 0;
+    }
+}
+
+static void check_fail(bench_result_t *result, const char *what, uint32_t slot) {
+    if (result->check_failures++ < 10) {
+        put_str(STDERR_FD, "heapbench: ");
+        put_str(STDERR_FD, what);
+        put_str(STDERR_FD, " in slot ");
+        put_u64(STDERR_FD, slot);
+        put_str(STDERR_FD, "\n");
+    }
+}
+
+static uint8_t pattern_byte(uint8_t seed, uint32_t i) {
+    return (uint8_t)(seed + i + (i >> 8));
+}
+
+static void fill_block(uint32_t slot) {
+    uint8_t *data = slots[slot];
+    uint32_t size = slot_sizes[slot];
+    if (!check_contents) {
+        // Touch the block like a real user would
+        memset(data, 0xA5, size < 64 ? size : 64);
+        return;
+    }
+    uint8_t seed = slot_seeds[slot] = next_seed++;
+    for (uint32_t i = 0; i < size; i++) data[i] = pattern_byte(seed, i);
+}
+
+// Checks the first len bytes of what the slot was last filled with.
+static void verify_block(const uint8_t *data, uint32_t slot, uint32_t len,
+                         bench_result_t *result, const char *what) {
+    if (!check_contents) return;
+    uint8_t seed = slot_seeds[slot];
+    for (uint32_t i = 0; i < len; i++) {
+        if (data[i] != pattern_byte(seed, i)) {
+            check_fail(result, what, slot);
+            return;
+        }
+    }
+}
+
+static void run_op(const trace_op_t *op, bench_result_t *result) {
+    if (op->slot >= MAX_SLOTS) die("slot out of range");
+    void **slot = &slots[op->slot];
+    uint32_t old_size = slot_sizes[op->slot];
+    if (*slot && op->kind != 'r') {
+        verify_block(*slot, op->slot, old_size, result, "block corrupted before free");
+    }
+
+    void *ptr = NULL;
+    uint64_t start = rdtsc();
+    if (op->kind == 'a') {
+        if (*slot) kfree(*slot);
+        ptr = kmalloc(op->size);
+    } else if (op->kind == 'm') {
+        if (*slot) kfree(*slot);
+        ptr = kmalloc_aligned(op->size, op->align);
+    } else if (op->kind == 'r') {
+        ptr = krealloc(*slot, op->size);
+    } else {
+        kfree(*slot);
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    result->ops++;
+    result->total_cycles += cycles;
+    if (cycles > result->worst_cycles) result->worst_cycles = cycles;
+
+    // A failed krealloc leaves the old block in place
+    if (op->kind == 'r' && !ptr && op->size) {
+        result->failures++;
+        return;
+    }
+
+    *slot = ptr;
+    result->live_bytes -= old_size;
+    slot_sizes[op->slot] = 0;
+    if (ptr) {
+        uint32_t align = op->kind == 'm' && op->align > MEM_ALIGN ? op->align : MEM_ALIGN;
+        if ((uint32_t)ptr & (align - 1)) check_fail(result, "misaligned block", op->slot);
+        // krealloc must carry the old bytes over, wherever the block went
+        if (op->kind == 'r') {
+            verify_block(ptr, op->slot, old_size < op->size ? old_size : op->size,
+                         result, "krealloc lost data");
+        }
+        slot_sizes[op->slot] = op->size;
+        result->live_bytes += op->size;
+        fill_block(op->slot);
+    } else if (op->kind != 'f' && op->size) {
+        result->failures++;
+    }
+    if (result->live_bytes > result->peak_live_bytes) {
+        result->peak_live_bytes = result->live_bytes;
+    }
+}
+
+static void write_op(int fd, const trace_op_t *op) {
+    char kind[2] = { op->kind, '\0' };
+    put_str(fd, kind);
+    put_str(fd, " ");
+    put_u64(fd, op->slot);
+    if (op->kind != 'f') {
+        put_str(fd, " ");
+        put_u64(fd, op->size);
+    }
+    if (op->kind == 'm') {
+        put_str(fd, " ");
+        put_u64(fd, op->align);
+    }
+    put_str(fd, "\n");
+}
+
+static bool parse_line(char *line, trace_op_t *op) {
+    while (*line == ' ') line++;
+    if (*line != 'a' && *line != 'm' && *line != 'r' && *line != 'f') return false;
+    op->kind = *line++;
+    while (*line == ' ') line++;
+    op->slot = parse_u32(line);
+    while (*line >= '0' && *line <= '9') line++;
+    while (*line == ' ') line++;
+    op->size = parse_u32(line);
+    while (*line >= '0' && *line <= '9') line++;
+    while (*line == ' ') line++;
+    op->align = parse_u32(line);
+    return true;
+}
+
+static void replay_file(const char *path, bench_result_t *result) {
+    static char buf[READ_CHUNK + 1];
+    int fd = sys_open(path, O_RDONLY, 0);
+    if (fd < 0) die("cannot open trace");
+
+    size_t have = 0;
+    for (;;) {
+        int got = sys_read(fd, buf + have, READ_CHUNK - have);
+        if (got < 0) die("read failed");
+        have += got;
+        if (have == 0) break;
+
+        size_t start = 0;
+        for (size_t i = 0; i < have; i++) {
+            if (buf[i] != '\n') continue;
+            buf[i] = '\0';
+            trace_op_t op;
+            if (parse_line(&buf[start], &op)) run_op(&op, result);
+            start = i + 1;
+        }
+        if (got == 0) {
+            buf[have] = '\0';
+            trace_op_t op;
+            if (start < have && parse_line(&buf[start], &op)) run_op(&op, result);
+            break;
+        }
+        if (start == 0 && have == READ_CHUNK) die("trace line too long");
+        memcpy(buf, buf + start, have - start);
+        have -= start;
+    }
+    sys_close(fd);
+}
+
+// Largest single block the heap can hand out without growing,
+// found by bisection with the heap window frozen.
+static uint32_t largest_allocatable(uint32_t limit) {
+    uint32_t lo = 0, hi = limit;
+    bench_heap_frozen = true;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo + 1) / 2;
+        void *ptr = kmalloc(mid);
+        if (ptr) {
+            kfree(ptr);
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    bench_heap_frozen = false;
+    return lo;
+}
+
+static void report(const char *label, uint64_t value, const char *unit) {
+    put_str(STDOUT_FD, label);
+    put_u64(STDOUT_FD, value);
+    put_str(STDOUT_FD, unit);
+    put_str(STDOUT_FD, "\n");
+}
+
+static void usage(void) {
+    put_str(STDERR_FD,
+            "usage: heapbench [-c] [-n ops] [-k slots] [-s seed] [-o out.trace] [trace]\n"
+            "  without a trace file a synthetic workload is generated;\n"
+            "  -o also writes that workload so it can be replayed later;\n"
+            "  -c checks block contents on free and across krealloc\n");
+    sys_exit(2);
+}
+
+void bench_main(uint32_t *stack) {
+    int argc = (int)stack[0];
+    char **argv = (char**)&stack[1];
+    uint32_t ops = DEFAULT_OPS;
+    uint32_t nslots = DEFAULT_SLOTS;
+    const char *trace_path = NULL;
+    const char *out_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] == 'c' && !argv[i][2]) {
+            check_contents = true;
+        } else if (argv[i][0] == '-' && i + 1 < argc) {
+            char flag = argv[i][1];
+            const char *value = argv[++i];
+            if (flag == 'n') ops = parse_u32(value);
+            else if (flag == 'k') nslots = parse_u32(value);
+            else if (flag == 's') rng_state = parse_u32(value) | 1;
+            else if (flag == 'o') out_path = value;
+            else usage();
+        } else if (argv[i][0] != '-') {
+            trace_path = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (nslots == 0 || nslots > MAX_SLOTS) die("slots must be 1..65536");
+
+    int out_fd = -1;
+    if (out_path) {
+        out_fd = sys_open(out_path, O_WRONLY_CREAT_TRUNC, 0644);
+        if (out_fd < 0) die("cannot create output trace");
+    }
+
+    memory_init();
+    bench_result_t result;
+    memset(&result, 0, sizeof(result));
+
+    uint64_t t0 = clock_ns();
+    if (trace_path) {
+        replay_file(trace_path, &result);
+    } else {
+        for (uint32_t i = 0; i < ops; i++) {
+            trace_op_t op;
+            synthetic_op(nslots, &op);
+            if (out_fd >= 0) write_op(out_fd, &op);
+            run_op(&op, &result);
+        }
+    }
+    uint64_t elapsed = clock_ns() - t0;
+    if (out_fd >= 0) sys_close(out_fd);
+    if (elapsed == 0) elapsed = 1;
+
+    uint32_t total, used, free_bytes;
+    memory_stats(&total, &used, &free_bytes);
+    uint32_t largest = largest_allocatable(free_bytes);
+
+    // Cycles to nanoseconds using the TSC rate seen over the whole run
+    uint32_t elapsed_us = (uint32_t)udiv64(elapsed, 1000);
+    uint64_t worst_ns = result.total_cycles
+        ? udiv64(result.worst_cycles * elapsed_us, (uint32_t)udiv64(result.total_cycles, 1000))
+        : 0;
+
+    put_str(STDOUT_FD, trace_path ? "trace:            " : "trace:            synthetic\n");
+    if (trace_path) {
+        put_str(STDOUT_FD, trace_path);
+        put_str(STDOUT_FD, "\n");
+    }
+    report("operations:       ", result.ops, "");
+    report("failed:           ", result.failures, "");
+    report("check failures:   ", result.check_failures, "");
+    report("elapsed:          ", elapsed_us, " us");
+    report("ops/sec:          ", udiv64(result.ops * 1000000ULL, elapsed_us ? elapsed_us : 1), "");
+    report("mean latency:     ", udiv64(result.total_cycles, result.ops ? result.ops : 1), " cycles");
+    report("worst latency:    ", result.worst_cycles, " cycles");
+    report("worst latency:    ", worst_ns, " ns (approx)");
+    report("peak live bytes:  ", result.peak_live_bytes, "");
+    report("heap footprint:   ", total, " bytes");
+    report("live at end:      ", result.live_bytes, " bytes");
+    report("free at end:      ", free_bytes, " bytes");
+    report("largest block:    ", largest, " bytes");
+    report("fragmentation:    ", free_bytes ? 100 - udiv64((uint64_t)largest * 100, free_bytes) : 0, " %");
+    report("footprint/peak:   ", result.peak_live_bytes ? udiv64((uint64_t)total * 100, (uint32_t)result.peak_live_bytes) : 0, " %");
+    sys_exit(result.check_failures ? 1 : 0);
+}
+
+__asm__(".globl _start\n"
+        "_start:\n"
+        "    mov %esp, %eax\n"
+        "    push %eax\n"
+        "    call bench_main\n");
@@ -0,0 +1,102 @@
+/* ================================================
+ * tools/heapbench/shim.c - Host shims for the heap benchmark
+ * ================================================ */
+#include "shim.h"
+#include "../../kernel/paging.h"
+#include "../../lib/string/string.h"
+
+#define SYS_EXIT 1
+#define SYS_READ 3
+#define SYS_WRITE 4
+#define SYS_OPEN 5
+#define SYS_CLOSE 6
+#define SYS_CLOCK_GETTIME 265
+#define CLOCK_MONOTONIC 1
+
+// Same size as the kernel heap window; the host only backs touched pages.
+static uint8_t heap_window[KERNEL_HEAP_MAX] __attribute__((aligned(4096)));
+static uint32_t heap_brk = 0;
+bool bench_heap_frozen = false;
+
+static int syscall3(int num, int a, int b, int c) {
+    int ret;
+    __asm__ volatile("int $0x80"
+                     : "=a"(ret)
+                     : "a"(num), "b"(a), "c"(b), "d"(c)
+                     : "memory");
+    return ret;
+}
+
+void sys_exit(int code) {
+    syscall3(SYS_EXIT, code, 0, 0);
+    for (;;);
+}
+
+int sys_open(const char *path, int flags, int mode) {
+    return syscall3(SYS_OPEN, (int)path, flags, mode);
+}
+
+int sys_read(int fd, void *buf, size_t len) {
+    return syscall3(SYS_READ, fd, (int)buf, len);
+}
+
+int sys_write(int fd, const void *buf, size_t len) {
+    return syscall3(SYS_WRITE, fd, (int)buf, len);
+}
+
+int sys_close(int fd) {
+    return syscall3(SYS_CLOSE, fd, 0, 0);
+}
+
+uint64_t clock_ns(void) {
+    struct {
+        int32_t sec;
+        int32_t nsec;
+    } ts;
+    syscall3(SYS_CLOCK_GETTIME, CLOCK_MONOTONIC, (int)&ts, 0);
+    return (uint64_t)ts.sec * 1000000000ULL + (uint64_t)ts.nsec;
+}
+
+uint64_t rdtsc(void) {
+    uint64_t value;
+    __asm__ volatile("rdtsc" : "=A"(value));
+    return value;
+}
+
+// Shift-subtract division, so no libgcc helper is needed on -m32.
+uint64_t udiv64(uint64_t n, uint32_t d) {
+    uint64_t q = 0;
+    uint64_t r = 0;
+    for (int i = 63; i >= 0; i--) {
+        r = (r << 1) | ((n >> i) & 1);
+        if (r >= d) {
+            r -= d;
+            q |= 1ULL << i;
+        }
+    }
+    return q;
+}
+
+void put_str(int fd, const char *s) {
+    sys_write(fd, s, strlen(s));
+}
+
+void put_u64(int fd, uint64_t value) {
+    char buf[24];
+    int i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    do {
+        uint64_t q = udiv64(value, 10);
+        buf[--i] = '0' + (char)(value - q * 10);
+        value = q;
+    } while (value);
+    put_str(fd, &buf[i]);
+}
+
+void *paging_heap_grow(size_t bytes) {
+    bytes = (bytes + 4095) & ~4095u;
+    if (bench_heap_frozen || bytes > KERNEL_HEAP_MAX - heap_brk) return NULL;
+    void *start = &heap_window[heap_brk];
+    heap_brk += bytes;
+    return start;
+}
@@ -0,0 +1,26 @@
+#ifndef HEAPBENCH_SHIM_H
+#define HEAPBENCH_SHIM_H
+
+#include "../../include/types.h"
+
+// Freestanding stand-ins for the pieces of libc and of the kernel that
+// kernel/memory.c and the benchmark need when run as a Linux process.
+
+#define STDOUT_FD 1
+#define STDERR_FD 2
+
+extern bool bench_heap_frozen;
+
+void sys_exit(int code);
+int sys_open(const char *path, int flags, int mode);
+int sys_read(int fd, void *buf, size_t len);
+int sys_write(int fd, const void *buf, size_t len);
+int sys_close(int fd);
+uint64_t clock_ns(void);
+uint64_t rdtsc(void);
+
+uint64_t udiv64(uint64_t n, uint32_t d);
+void put_str(int fd, const char *s);
+void put_u64(int fd, uint64_t value);
+
+#endif
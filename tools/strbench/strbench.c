@@ -0,0 +1,206 @@
+/* ================================================
+ * tools/strbench/strbench.c - lib/string checks and throughput
+ * Cross-checks every dispatched variant of strlen, memchr,
+ * memcmp, memmem and strstr against naive byte loops, then times
+ * the baseline and SSE2 variants on 64 KB buffers.
+ * ================================================ */
+#include "../heapbench/shim.h"
+#include "../../lib/string/string.h"
+
+#define BUF_SIZE 65536
+#define CHECK_SIZE 300
+#define BENCH_BYTES (256u << 20)    // Bytes scanned per timed run
+
+static uint8_t buf_a[BUF_SIZE + 64];
+static uint8_t buf_b[BUF_SIZE + 64];
+static uint32_t rng_state = 12345;
+static uint32_t failures = 0;
+static volatile uint32_t sink;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void fail(const char *what, uint32_t len, uint32_t pos) {
+    if (failures++ < 10) {
+        put_str(STDERR_FD, "FAIL ");
+        put_str(STDERR_FD, what);
+        put_str(STDERR_FD, " len=");
+        put_u64(STDERR_FD, len);
+        put_str(STDERR_FD, " pos=");
+        put_u64(STDERR_FD, pos);
+        put_str(STDERR_FD, "\n");
+    }
+}
+
+static const void *ref_memchr(const uint8_t *s, uint8_t c, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == c) return &s[i];
+    }
+    return NULL;
+}
+
+static int ref_sign_memcmp(const uint8_t *a, const uint8_t *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static const void *ref_memmem(const uint8_t *h, size_t hlen, const uint8_t *n, size_t nlen) {
+    if (nlen == 0) return h;
+    for (size_t i = 0; i + nlen <= hlen; i++) {
+        if (ref_sign_memcmp(h + i, n, nlen) == 0) return h + i;
+    }
+    return NULL;
+}
+
+static int sign(int v) {
+    return (v > 0) - (v < 0);
+}
+
+static void check_strlen(void) {
+    for (uint32_t align = 0; align < 16; align++) {
+        for (uint32_t len = 0; len < CHECK_SIZE; len++) {
+            char *s = (char*)buf_a + align;
+            // Zeros before the start must not end the string early
+            if (align) s[-1] = '\0';
+            for (uint32_t i = 0; i < len; i++) s[i] = 'a' + rng_next() % 26;
+            s[len] = '\0';
+            for (uint32_t i = len + 1; i < len + 32; i++) s[i] = rng_next();
+            if (strlen(s) != len) fail("strlen", len, align);
+        }
+    }
+}
+
+static void check_memchr(void) {
+    for (uint32_t align = 0; align < 16; align++) {
+        for (uint32_t len = 0; len < CHECK_SIZE; len++) {
+            uint8_t *s = buf_a + align;
+            for (uint32_t i = 0; i < len + 32; i++) s[i] = 'a' + rng_next() % 4;
+            // Sentinels just outside the range must never be reported
+            if (align) s[-1] = 'z';
+            s[len] = 'z';
+            uint8_t c = (rng_next() & 1) ? 'z' : 'a' + rng_next() % 4;
+            if (memchr(s, c, len) != ref_memchr(s, c, len)) fail("memchr", len, align);
+        }
+    }
+}
+
+static void check_memcmp(void) {
+    for (uint32_t align = 0; align < 16; align++) {
+        for (uint32_t len = 0; len < CHECK_SIZE; len++) {
+            uint8_t *a = buf_a + align;
+            uint8_t *b = buf_b + (align * 7) % 16;
+            for (uint32_t i = 0; i < len; i++) a[i] = b[i] = rng_next();
+            if (len && (rng_next() & 1)) {
+                uint32_t pos = rng_next() % len;
+                b[pos] ^= 1 << (rng_next() % 8);
+            }
+            if (sign(memcmp(a, b, len)) != ref_sign_memcmp(a, b, len)) fail("memcmp", len, align);
+        }
+    }
+}
+
+static void check_memmem(void) {
+    for (uint32_t round = 0; round < 20000; round++) {
+        uint32_t hlen = rng_next() % CHECK_SIZE;
+        uint32_t nlen = rng_next() % 24;
+        uint8_t *h = buf_a + rng_next() % 16;
+        uint8_t *n = buf_b;
+        // Small alphabet so partial matches are common
+        for (uint32_t i = 0; i < hlen; i++) h[i] = 'a' + rng_next() % 3;
+        for (uint32_t i = 0; i < nlen; i++) n[i] = 'a' + rng_next() % 3;
+        if (nlen && hlen >= nlen && (rng_next() & 1)) {
+            memcpy(h + rng_next() % (hlen - nlen + 1), n, nlen);
+        }
+        if (memmem(h, hlen, n, nlen) != ref_memmem(h, hlen, n, nlen)) fail("memmem", hlen, nlen);
+
+        h[hlen] = '\0';
+        n[nlen] = '\0';
+        if ((const void*)strstr((char*)h, (char*)n) != ref_memmem(h, hlen, n, nlen)) {
+            fail("strstr", hlen, nlen);
+        }
+    }
+}
+
+static void run_checks(const char *variant) {
+    uint32_t before = failures;
+    check_strlen();
+    check_memchr();
+    check_memcmp();
+    check_memmem();
+    put_str(STDOUT_FD, variant);
+    put_str(STDOUT_FD, failures == before ? ": checks passed\n" : ": checks FAILED\n");
+}
+
+static void report_rate(const char *label, uint64_t bytes, uint64_t ns) {
+    put_str(STDOUT_FD, label);
+    uint32_t us = (uint32_t)udiv64(ns, 1000);
+    put_u64(STDOUT_FD, udiv64(bytes, us ? us : 1));     // Bytes per us = MB/s
+    put_str(STDOUT_FD, " MB/s\n");
+}
+
+static void run_throughput(void) {
+    uint32_t rounds = BENCH_BYTES / BUF_SIZE;
+
+    // Match only in the final byte, so every call scans the whole buffer
+    memset(buf_a, 'a', BUF_SIZE);
+    buf_a[BUF_SIZE - 1] = 'z';
+    memcpy(buf_b, buf_a, BUF_SIZE);
+
+    // buf_a has slack past BUF_SIZE for the terminator
+    buf_a[BUF_SIZE] = '\0';
+    uint64_t t0 = clock_ns();
+    for (uint32_t i = 0; i < rounds; i++) sink += strlen((const char*)buf_a);
+    report_rate("  strlen:  ", BENCH_BYTES, clock_ns() - t0);
+
+    t0 = clock_ns();
+    for (uint32_t i = 0; i < rounds; i++) sink += (uint32_t)memchr(buf_a, 'z', BUF_SIZE);
+    report_rate("  memchr:  ", BENCH_BYTES, clock_ns() - t0);
+
+    t0 = clock_ns();
+    for (uint32_t i = 0; i < rounds; i++) sink += memcmp(buf_a, buf_b, BUF_SIZE);
+    report_rate("  memcmp:  ", BENCH_BYTES, clock_ns() - t0);
+
+    // Text-like haystack where the needle's first byte is frequent
+    for (uint32_t i = 0; i < BUF_SIZE; i++) buf_a[i] = "the quick brown fox "[i % 20];
+    const char *needle = "the quick brown cat";
+    memcpy(buf_a + BUF_SIZE - 19, needle, 19);
+
+    t0 = clock_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+        sink += (uint32_t)memmem(buf_a, BUF_SIZE, needle, 19);
+    }
+    report_rate("  memmem:  ", BENCH_BYTES, clock_ns() - t0);
+}
+
+void bench_main(void) {
+    // A Linux host always has SSE state enabled, so both sets are safe here
+    static const struct {
+        uint32_t caps;
+        const char *name;
+    } variants[] = {
+        { 0, "i386" },
+        { STRING_CAP_SSE2, "sse2" },
+    };
+
+    for (uint32_t v = 0; v < 2; v++) {
+        string_select(variants[v].caps);
+        run_checks(variants[v].name);
+    }
+    for (uint32_t v = 0; v < 2; v++) {
+        string_select(variants[v].caps);
+        put_str(STDOUT_FD, variants[v].name);
+        put_str(STDOUT_FD, " throughput:\n");
+        run_throughput();
+    }
+    sys_exit(failures ? 1 : 0);
+}
+
+__asm__(".globl _start\n"
+        "_start:\n"
+        "    call bench_main\n");